@@ -0,0 +1,965 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+#include <fcntl.h>
+
+#include "fwdtapp.h"
+#include "fwdt.h"
+#include "fwdt_sim.h"
+
+/*
+ * Measures every access type through every interface the driver offers:
+ * the sysfs address/data attributes, one ioctl per access, batches, the
+ * range commands, the submission ring and mmap()ed MMIO. Only reads are
+ * issued. With -s the ioctls go to the simulated devices of libfwdtsim
+ * instead of /dev/fwdt, which covers the paths built from fwdt_core.c.
+ */
+
+#define SYSFS_DIR	"/sys/devices/platform/fwdt/"
+#define DMI_DIR		"/sys/class/dmi/id/"
+#define DEFAULT_LCD	"\\_SB.PCI0.GFX0.LCD"
+#define MAX_BULK	256
+
+enum bench_path {
+	PATH_SYSFS,
+	PATH_IOCTL,
+	PATH_BATCH,
+	PATH_RANGE,
+	PATH_RING,
+	PATH_MMAP,
+	NUM_PATHS,
+};
+
+static const char *path_names[NUM_PATHS] = {
+	"sysfs", "ioctl", "batch", "range", "ring", "mmap",
+};
+
+enum bench_format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_JSON,
+};
+
+/* worker status */
+#define BENCH_OK		0
+#define BENCH_UNSUPPORTED	1	/* setup or the first access failed */
+#define BENCH_FAILED		2	/* an access failed while measuring */
+
+static const char *status_names[] = { "ok", "unsupported", "failed" };
+
+struct bench_target {
+	const char *name;
+	u16 target;		/* FWDT_TARGET_* */
+	u16 func;		/* for batches and rings */
+	u32 device;		/* PCI: FWDT_PCI_DEVICE(), MSR: cpu */
+	u64 address;
+	const char *sysfs_addr;
+	const char *sysfs_data;
+	unsigned int paths;	/* 1 << PATH_* */
+};
+
+#define P(path)		(1 << PATH_##path)
+
+static struct bench_target targets[] = {
+	{ "io", FWDT_TARGET_IO, GET_DATA_BYTE, 0, 0x80,
+	  "iob_address", "iob_data",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RANGE) | P(RING) },
+	{ "mem", FWDT_TARGET_MEMORY, GET_DATA_DWORD, 0, 0,
+	  "mem_address", "mem_data",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RING) | P(MMAP) },
+	{ "cmos", FWDT_TARGET_CMOS, GET_DATA_BYTE, 0, 0x10,
+	  "cmos", "cmos",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RANGE) | P(RING) },
+	{ "pci", FWDT_TARGET_PCI, GET_DATA_DWORD, 0, 0x00,
+	  "pci_reg", "pci_data",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RANGE) | P(RING) },
+	{ "ec", FWDT_TARGET_EC, GET_DATA_BYTE, 0, 0x00,
+	  "ec_address", "ec_data",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RANGE) | P(RING) },
+	{ "msr", FWDT_TARGET_MSR, GET_DATA_QWORD, 0, 0x10,
+	  "msr", "msr",
+	  P(SYSFS) | P(IOCTL) | P(BATCH) | P(RING) },
+	{ "acpi", FWDT_TARGET_ACPI, GET_DATA_QWORD, 0, 0,
+	  NULL, "acpi_method_0_1",
+	  P(SYSFS) | P(IOCTL) | P(RING) },
+};
+
+#define NUM_TARGETS	(sizeof(targets) / sizeof(targets[0]))
+
+/* what the simulated backend implements */
+static const unsigned int sim_paths[NUM_TARGETS] = {
+	P(IOCTL) | P(BATCH) | P(RANGE),		/* io */
+	P(IOCTL) | P(BATCH),			/* mem */
+	P(IOCTL) | P(BATCH) | P(RANGE),		/* cmos */
+	P(BATCH),				/* pci */
+	P(IOCTL) | P(BATCH) | P(RANGE),		/* ec */
+	P(BATCH),				/* msr */
+	P(IOCTL),				/* acpi */
+};
+
+static struct {
+	const char *device;
+	bool sim;
+	unsigned long latency;
+	int calls;
+	int bulk;
+	int workers;
+	bool processes;
+	enum bench_format format;
+	char *targets;
+	char *paths;
+	bool mem_address;
+	char lcd[128];
+} opt = {
+	.device = "/dev/fwdt",
+	.calls = 10000,
+	.bulk = 64,
+	.workers = 1,
+	.lcd = DEFAULT_LCD,
+};
+
+struct bench_worker {
+	/* shared with the parent */
+	int status;
+	int done;
+	unsigned long long start;
+	unsigned long long end;
+	unsigned long long *lat;
+
+	/* private to the worker */
+	struct bench_target *t;
+	enum bench_path path;
+	int fd;
+	int addr_fd;
+	int data_fd;
+	int ops;
+	struct fwdt_batch_op *batch_ops;
+	struct fwdt_batch_result *batch_results;
+	u8 *buf;
+	struct fwdt_msr_matrix matrix;
+	u32 msr;
+	u64 cpu_mask;
+	u64 msr_values[64];
+	int msr_status[64];
+	struct fwdt_ring_header *ring;
+	u32 ring_bytes;
+	u32 ring_method;
+	volatile u32 *mmio;
+	void *mmio_map;
+	size_t mmio_size;
+};
+
+struct bench_shared {
+	pthread_barrier_t barrier;
+	struct bench_worker workers[];
+};
+
+static unsigned long long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long bench_ioctl(struct bench_worker *w, unsigned long cmd, void *arg) {
+	if (opt.sim)
+		return fwdt_sim_ioctl(cmd, arg);
+
+	return ioctl(w->fd, cmd, arg);
+}
+
+/* the ioctl succeeded and so did the command */
+static int bench_cmd(struct bench_worker *w, unsigned long cmd, void *arg) {
+	if (bench_ioctl(w, cmd, arg))
+		return FWDT_FAIL;
+
+	return ((fwdt_generic *) arg)->parameters.func_status == FWDT_SUCCESS ?
+		0 : FWDT_FAIL;
+}
+
+static int sysfs_open(const char *name) {
+	char path[128];
+
+	snprintf(path, sizeof(path), SYSFS_DIR "%s", name);
+
+	return open(path, O_RDWR);
+}
+
+static int sysfs_printf(int fd, const char *fmt, ...) {
+	char buf[300];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	return pwrite(fd, buf, len, 0) == len ? 0 : FWDT_FAIL;
+}
+
+static int run_sysfs(struct bench_worker *w) {
+	char buf[64];
+	int i;
+
+	for (i = 0; i < w->ops; i++) {
+		if (w->addr_fd >= 0 &&
+		    sysfs_printf(w->addr_fd, "%llx", (unsigned long long) w->t->address))
+			return FWDT_FAIL;
+		if (pread(w->data_fd, buf, sizeof(buf), 0) <= 0)
+			return FWDT_FAIL;
+	}
+
+	return 0;
+}
+
+static int run_ioctl(struct bench_worker *w) {
+	struct bench_target *t = w->t;
+	struct fwdt_io_data io;
+	struct fwdt_mem_data mem;
+	struct fwdt_cmos_data cmos;
+	struct fwdt_pci_config pci;
+	struct fwdt_ec_range ec;
+	struct fwdt_brightness br;
+
+	switch (t->target) {
+	case FWDT_TARGET_IO:
+		io.parameters.func = GET_DATA_BYTE;
+		io.io_address = t->address;
+		return bench_cmd(w, FWDT_HW_ACCESS_IO_CMD, &io);
+	case FWDT_TARGET_MEMORY:
+		mem.parameters.func = GET_DATA_DWORD;
+		mem.mem_address = t->address;
+		return bench_cmd(w, FWDT_HW_ACCESS_MEMORY_CMD, &mem);
+	case FWDT_TARGET_CMOS:
+		cmos.parameters.func = GET_DATA_BYTE;
+		cmos.cmos_address = t->address;
+		return bench_cmd(w, FWDT_HW_ACCESS_CMOS_CMD, &cmos);
+	case FWDT_TARGET_PCI:
+		pci.parameters.func = READ_PCI_CONFIG;
+		pci.device = t->device;
+		pci.offset = t->address;
+		pci.length = 4;
+		pci.buffer = (unsigned long) w->buf;
+		return bench_cmd(w, FWDT_PCI_CONFIG_CMD, &pci);
+	case FWDT_TARGET_EC:
+		ec.parameters.func = READ_EC_RANGE;
+		ec.offset = t->address;
+		ec.length = 1;
+		return bench_cmd(w, FWDT_EC_RANGE_CMD, &ec);
+	case FWDT_TARGET_MSR:
+		w->matrix.parameters.func = READ_MSR_MATRIX;
+		return bench_cmd(w, FWDT_MSR_MATRIX_CMD, &w->matrix) ||
+			w->msr_status[t->device] != FWDT_SUCCESS;
+	case FWDT_TARGET_ACPI:
+		br.parameters.func = GET_BRIGHTNESS;
+		strcpy(br.lcd_path, opt.lcd);
+		return bench_cmd(w, FWDT_ACPI_VGA_CMD, &br);
+	}
+
+	return FWDT_FAIL;
+}
+
+static int run_batch(struct bench_worker *w) {
+	struct fwdt_batch fb;
+
+	fb.parameters.func = RUN_BATCH;
+	fb.num_ops = w->ops;
+	fb.ops = (unsigned long) w->batch_ops;
+	fb.results = (unsigned long) w->batch_results;
+
+	return bench_cmd(w, FWDT_BATCH_CMD, &fb);
+}
+
+static int run_range(struct bench_worker *w) {
+	struct bench_target *t = w->t;
+	struct fwdt_io_range io;
+	struct fwdt_cmos_range cmos;
+	struct fwdt_pci_config pci;
+	struct fwdt_ec_range ec;
+
+	switch (t->target) {
+	case FWDT_TARGET_IO:
+		/* the same port over and over; neighbours may not be benign */
+		io.parameters.func = READ_IO_FIFO;
+		io.io_address = t->address;
+		io.width = 1;
+		io.count = w->ops;
+		io.buffer = (unsigned long) w->buf;
+		return bench_cmd(w, FWDT_IO_RANGE_CMD, &io);
+	case FWDT_TARGET_CMOS:
+		cmos.parameters.func = READ_CMOS_RANGE;
+		cmos.offset = t->address;
+		cmos.length = w->ops;
+		return bench_cmd(w, FWDT_CMOS_RANGE_CMD, &cmos);
+	case FWDT_TARGET_PCI:
+		pci.parameters.func = READ_PCI_CONFIG;
+		pci.device = t->device;
+		pci.offset = t->address;
+		pci.length = w->ops;
+		pci.buffer = (unsigned long) w->buf;
+		return bench_cmd(w, FWDT_PCI_CONFIG_CMD, &pci);
+	case FWDT_TARGET_EC:
+		ec.parameters.func = READ_EC_RANGE;
+		ec.offset = t->address;
+		ec.length = w->ops;
+		return bench_cmd(w, FWDT_EC_RANGE_CMD, &ec);
+	}
+
+	return FWDT_FAIL;
+}
+
+static int run_ring(struct bench_worker *w) {
+	struct fwdt_ring_header *h = w->ring;
+	struct fwdt_ring_sqe *sqes = (void *) ((u8 *) h + h->sq_offset);
+	struct fwdt_ring_cqe *cqes = (void *) ((u8 *) h + h->cq_offset);
+	struct bench_target *t = w->t;
+	struct fwdt_ring_sqe *sqe;
+	struct fwdt_ring fr;
+	u32 tail = h->sq_tail;
+	u32 head, cq_tail;
+	int i, done = 0, err = 0;
+
+	for (i = 0; i < w->ops; i++) {
+		sqe = &sqes[(tail + i) & (h->sq_entries - 1)];
+		sqe->func = t->func;
+		sqe->target = t->target;
+		sqe->device = t->target == FWDT_TARGET_ACPI ?
+			w->ring_method : t->device;
+		sqe->address = t->address;
+		sqe->data = 0;
+		sqe->user_data = i;
+	}
+	__sync_synchronize();
+	h->sq_tail = tail + w->ops;
+
+	while (done < w->ops) {
+		memset(&fr, 0, sizeof(fr));
+		fr.parameters.func = ENTER_RING;
+		fr.min_complete = w->ops - done;
+		if (bench_cmd(w, FWDT_RING_CMD, &fr))
+			return FWDT_FAIL;
+
+		head = h->cq_head;
+		cq_tail = h->cq_tail;
+		__sync_synchronize();
+		for (; head != cq_tail; head++, done++)
+			if (cqes[head & (h->cq_entries - 1)].status)
+				err = FWDT_FAIL;
+		__sync_synchronize();
+		h->cq_head = head;
+	}
+
+	return err;
+}
+
+static int run_mmap(struct bench_worker *w) {
+	int i;
+
+	for (i = 0; i < w->ops; i++)
+		(void) *w->mmio;
+
+	return 0;
+}
+
+static int (*const run_path[NUM_PATHS])(struct bench_worker *w) = {
+	run_sysfs, run_ioctl, run_batch, run_range, run_ring, run_mmap,
+};
+
+/* read the vendor and device ID so pci_id can select the function */
+static int setup_sysfs_pci(struct bench_worker *w) {
+	struct fwdt_batch_op op;
+	struct fwdt_batch_result res;
+	struct fwdt_batch fb;
+	int fd, err;
+
+	memset(&op, 0, sizeof(op));
+	op.func = GET_DATA_DWORD;
+	op.target = FWDT_TARGET_PCI;
+	op.device = w->t->device;
+
+	fb.parameters.func = RUN_BATCH;
+	fb.num_ops = 1;
+	fb.ops = (unsigned long) &op;
+	fb.results = (unsigned long) &res;
+	if (bench_cmd(w, FWDT_BATCH_CMD, &fb))
+		return FWDT_FAIL;
+
+	fd = sysfs_open("pci_id");
+	if (fd < 0)
+		return FWDT_FAIL;
+	err = sysfs_printf(fd, "%04x:%04x\n", (u32) res.data & 0xFFFF,
+			   (u32) (res.data >> 16) & 0xFFFF);
+	close(fd);
+
+	return err;
+}
+
+static int setup_sysfs(struct bench_worker *w) {
+	struct bench_target *t = w->t;
+
+	if (t->target == FWDT_TARGET_PCI && setup_sysfs_pci(w))
+		return FWDT_FAIL;
+
+	w->data_fd = sysfs_open(t->sysfs_data);
+	if (w->data_fd < 0)
+		return FWDT_FAIL;
+
+	/* acpi_method_0_1 takes the path without the root backslash */
+	if (t->target == FWDT_TARGET_ACPI)
+		return sysfs_printf(w->data_fd, "%s._BQC\n", opt.lcd + 1);
+
+	if (!strcmp(t->sysfs_addr, t->sysfs_data))
+		w->addr_fd = w->data_fd;
+	else
+		w->addr_fd = sysfs_open(t->sysfs_addr);
+
+	return w->addr_fd < 0 ? FWDT_FAIL : 0;
+}
+
+static int setup_ring(struct bench_worker *w) {
+	struct fwdt_ring fr;
+	u32 entries = 1;
+	void *map;
+
+	while (entries < w->ops)
+		entries <<= 1;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.parameters.func = SETUP_RING;
+	fr.sq_entries = entries;
+	fr.cq_entries = entries;
+	if (bench_cmd(w, FWDT_RING_CMD, &fr))
+		return FWDT_FAIL;
+
+	map = mmap(NULL, fr.ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   w->fd, 0);
+	if (map == MAP_FAILED)
+		return FWDT_FAIL;
+	w->ring = map;
+	w->ring_bytes = fr.ring_bytes;
+
+	if (w->t->target != FWDT_TARGET_ACPI)
+		return 0;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.parameters.func = REGISTER_RING_METHOD;
+	snprintf(fr.path, sizeof(fr.path), "%s._BQC", opt.lcd);
+	if (bench_cmd(w, FWDT_RING_CMD, &fr))
+		return FWDT_FAIL;
+	w->ring_method = fr.method;
+
+	return 0;
+}
+
+/* the window is global to the driver, so every worker adds its own */
+static int setup_mmap(struct bench_worker *w) {
+	struct fwdt_mmap_window fw;
+	long page = sysconf(_SC_PAGESIZE);
+	u64 base = w->t->address & ~(u64) (page - 1);
+	void *map;
+
+	fw.parameters.func = ADD_MMAP_WINDOW;
+	fw.base = base;
+	fw.size = page;
+	if (bench_cmd(w, FWDT_MMAP_WINDOW_CMD, &fw))
+		return FWDT_FAIL;
+
+	map = mmap(NULL, page, PROT_READ, MAP_SHARED, w->fd, base);
+	if (map == MAP_FAILED)
+		return FWDT_FAIL;
+	w->mmio_map = map;
+	w->mmio_size = page;
+	w->mmio = (volatile u32 *) ((u8 *) map + (w->t->address - base));
+
+	return 0;
+}
+
+static int setup(struct bench_worker *w) {
+	struct bench_target *t = w->t;
+	int i;
+
+	w->fd = -1;
+	w->addr_fd = -1;
+	w->data_fd = -1;
+
+	/* sysfs and single ioctls do one access per call unless bulk */
+	w->ops = w->path == PATH_IOCTL ? 1 : opt.bulk;
+	if (w->path == PATH_RANGE && t->target != FWDT_TARGET_IO &&
+	    t->address + w->ops > (t->target == FWDT_TARGET_PCI ? 4096 : 256))
+		return FWDT_FAIL;
+
+	if (!opt.sim) {
+		w->fd = open(opt.device, O_RDWR);
+		if (w->fd < 0)
+			return FWDT_FAIL;
+	}
+
+	w->buf = calloc(1, 4096);
+	w->batch_ops = calloc(opt.bulk, sizeof(*w->batch_ops));
+	w->batch_results = calloc(opt.bulk, sizeof(*w->batch_results));
+	if (!w->buf || !w->batch_ops || !w->batch_results)
+		return FWDT_FAIL;
+
+	for (i = 0; i < opt.bulk; i++) {
+		w->batch_ops[i].func = t->func;
+		w->batch_ops[i].target = t->target;
+		w->batch_ops[i].device = t->device;
+		w->batch_ops[i].address = t->address;
+	}
+
+	w->msr = t->address;
+	w->cpu_mask = 1ULL << t->device;
+	w->matrix.num_msrs = 1;
+	w->matrix.num_cpus = t->device + 1;
+	w->matrix.msrs = (unsigned long) &w->msr;
+	w->matrix.cpu_mask = (unsigned long) &w->cpu_mask;
+	w->matrix.values = (unsigned long) w->msr_values;
+	w->matrix.status = (unsigned long) w->msr_status;
+	if (t->target == FWDT_TARGET_MSR && t->device >= 64)
+		return FWDT_FAIL;
+
+	switch (w->path) {
+	case PATH_SYSFS:
+		if (setup_sysfs(w))
+			return FWDT_FAIL;
+		break;
+	case PATH_RING:
+		if (setup_ring(w))
+			return FWDT_FAIL;
+		break;
+	case PATH_MMAP:
+		if (setup_mmap(w))
+			return FWDT_FAIL;
+		break;
+	default:
+		break;
+	}
+
+	/* a target that is absent shows up as unsupported, not failed */
+	return run_path[w->path](w);
+}
+
+static void teardown(struct bench_worker *w) {
+	struct fwdt_mmap_window fw;
+
+	if (w->mmio_map) {
+		munmap(w->mmio_map, w->mmio_size);
+		fw.parameters.func = DEL_MMAP_WINDOW;
+		fw.base = (unsigned long) (w->t->address & ~(u64) (w->mmio_size - 1));
+		fw.size = w->mmio_size;
+		bench_ioctl(w, FWDT_MMAP_WINDOW_CMD, &fw);
+	}
+	if (w->ring)
+		munmap(w->ring, w->ring_bytes);
+	if (w->addr_fd >= 0 && w->addr_fd != w->data_fd)
+		close(w->addr_fd);
+	if (w->data_fd >= 0)
+		close(w->data_fd);
+	if (w->fd >= 0)
+		close(w->fd);
+	free(w->batch_results);
+	free(w->batch_ops);
+	free(w->buf);
+}
+
+static struct bench_shared *shared;
+
+static void *worker_main(void *arg) {
+	struct bench_worker *w = arg;
+	unsigned long long t0;
+	int i;
+
+	w->status = setup(w) ? BENCH_UNSUPPORTED : BENCH_OK;
+	pthread_barrier_wait(&shared->barrier);
+
+	if (w->status == BENCH_OK) {
+		w->start = now_ns();
+		for (i = 0; i < opt.calls; i++) {
+			t0 = now_ns();
+			if (run_path[w->path](w)) {
+				w->status = BENCH_FAILED;
+				break;
+			}
+			w->lat[i] = now_ns() - t0;
+		}
+		w->end = now_ns();
+		w->done = i;
+	}
+
+	teardown(w);
+	return NULL;
+}
+
+static int cmp_ull(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static unsigned long long percentile(unsigned long long *v, size_t n,
+				     int pct) {
+	if (!n)
+		return 0;
+
+	return v[(n - 1) * pct / 100];
+}
+
+static char kernel_release[65];
+static char bios_version[128];
+static char bios_date[64];
+static bool first_result = true;
+
+static void read_dmi(const char *name, char *buf, size_t size) {
+	char path[128];
+	FILE *f;
+
+	snprintf(path, sizeof(path), DMI_DIR "%s", name);
+	buf[0] = 0;
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (fgets(buf, size, f))
+		buf[strcspn(buf, "\n")] = 0;
+	fclose(f);
+}
+
+static void print_header(void) {
+	struct utsname u;
+
+	if (!uname(&u))
+		snprintf(kernel_release, sizeof(kernel_release), "%s", u.release);
+	read_dmi("bios_version", bios_version, sizeof(bios_version));
+	read_dmi("bios_date", bios_date, sizeof(bios_date));
+
+	switch (opt.format) {
+	case FORMAT_TEXT:
+		printf("kernel %s, bios %s (%s), %s, %d %s, %d calls each\n",
+		       kernel_release, bios_version, bios_date,
+		       opt.sim ? "simulated devices" : opt.device,
+		       opt.workers, opt.processes ? "processes" : "threads",
+		       opt.calls);
+		printf("%-6s %-6s %7s %12s %10s %10s %10s %10s\n",
+		       "target", "path", "ops/call", "ops/s", "p50 ns",
+		       "p90 ns", "p99 ns", "max ns");
+		break;
+	case FORMAT_CSV:
+		printf("kernel,bios_version,bios_date,backend,target,path,mode,"
+		       "workers,ops_per_call,calls,ops,seconds,ops_per_sec,"
+		       "p50_ns,p90_ns,p99_ns,max_ns,status\n");
+		break;
+	case FORMAT_JSON:
+		printf("{\n  \"kernel\": \"%s\",\n  \"bios_version\": \"%s\",\n"
+		       "  \"bios_date\": \"%s\",\n  \"backend\": \"%s\",\n"
+		       "  \"results\": [", kernel_release, bios_version,
+		       bios_date, opt.sim ? "sim" : "driver");
+		break;
+	}
+}
+
+static void print_footer(void) {
+	if (opt.format == FORMAT_JSON)
+		printf("\n  ]\n}\n");
+}
+
+static void print_result(struct bench_target *t, enum bench_path path,
+			 int status, int ops, unsigned long long calls,
+			 double seconds, unsigned long long *lat) {
+	unsigned long long total = calls * ops;
+	double rate = seconds > 0 ? total / seconds : 0;
+	unsigned long long p50 = percentile(lat, calls, 50);
+	unsigned long long p90 = percentile(lat, calls, 90);
+	unsigned long long p99 = percentile(lat, calls, 99);
+	unsigned long long max = calls ? lat[calls - 1] : 0;
+
+	switch (opt.format) {
+	case FORMAT_TEXT:
+		if (status != BENCH_OK) {
+			printf("%-6s %-6s %s\n", t->name, path_names[path],
+			       status_names[status]);
+			break;
+		}
+		printf("%-6s %-6s %7d %12.0f %10llu %10llu %10llu %10llu\n",
+		       t->name, path_names[path], ops, rate, p50, p90, p99,
+		       max);
+		break;
+	case FORMAT_CSV:
+		printf("\"%s\",\"%s\",\"%s\",%s,%s,%s,%s,%d,%d,%llu,%llu,"
+		       "%.6f,%.0f,%llu,%llu,%llu,%llu,%s\n",
+		       kernel_release, bios_version, bios_date,
+		       opt.sim ? "sim" : "driver", t->name, path_names[path],
+		       opt.processes ? "process" : "thread", opt.workers, ops,
+		       calls, total, seconds, rate, p50, p90, p99, max,
+		       status_names[status]);
+		break;
+	case FORMAT_JSON:
+		printf("%s\n    { \"target\": \"%s\", \"path\": \"%s\", "
+		       "\"mode\": \"%s\", \"workers\": %d, "
+		       "\"ops_per_call\": %d, \"calls\": %llu, \"ops\": %llu, "
+		       "\"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+		       "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, "
+		       "\"max_ns\": %llu, \"status\": \"%s\" }",
+		       first_result ? "" : ",", t->name, path_names[path],
+		       opt.processes ? "process" : "thread", opt.workers, ops,
+		       calls, total, seconds, rate, p50, p90, p99, max,
+		       status_names[status]);
+		first_result = false;
+		break;
+	}
+	fflush(stdout);
+}
+
+static int bench_one(struct bench_target *t, enum bench_path path) {
+	size_t size = sizeof(*shared) + opt.workers * sizeof(shared->workers[0]);
+	size_t lat_size = (size_t) opt.workers * opt.calls * sizeof(*shared->workers[0].lat);
+	pthread_barrierattr_t attr;
+	pthread_t *threads = NULL;
+	unsigned long long *lat, *all;
+	unsigned long long start = ~0ULL, end = 0, calls = 0;
+	struct bench_worker *w;
+	int status = BENCH_OK;
+	int i, ops = 0;
+	pid_t pid;
+
+	shared = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	lat = mmap(NULL, lat_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	all = malloc(lat_size);
+	if (shared == MAP_FAILED || lat == MAP_FAILED || !all) {
+		printf("out of memory\n");
+		return FWDT_FAIL;
+	}
+
+	pthread_barrierattr_init(&attr);
+	pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_barrier_init(&shared->barrier, &attr, opt.workers);
+	pthread_barrierattr_destroy(&attr);
+
+	for (i = 0; i < opt.workers; i++) {
+		w = &shared->workers[i];
+		w->t = t;
+		w->path = path;
+		w->lat = lat + (size_t) i * opt.calls;
+	}
+
+	if (opt.processes) {
+		for (i = 0; i < opt.workers; i++) {
+			pid = fork();
+			if (pid == 0) {
+				worker_main(&shared->workers[i]);
+				_exit(0);
+			}
+		}
+		while (wait(NULL) > 0)
+			;
+	} else {
+		threads = calloc(opt.workers, sizeof(*threads));
+		for (i = 0; i < opt.workers; i++)
+			pthread_create(&threads[i], NULL, worker_main,
+				       &shared->workers[i]);
+		for (i = 0; i < opt.workers; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	}
+
+	for (i = 0; i < opt.workers; i++) {
+		w = &shared->workers[i];
+		if (w->status > status)
+			status = w->status;
+		if (w->status == BENCH_UNSUPPORTED)
+			continue;
+		memcpy(all + calls, w->lat, w->done * sizeof(*all));
+		calls += w->done;
+		ops = path == PATH_IOCTL ? 1 : opt.bulk;
+		if (w->start < start)
+			start = w->start;
+		if (w->end > end)
+			end = w->end;
+	}
+
+	if (status == BENCH_UNSUPPORTED)
+		calls = 0;
+	qsort(all, calls, sizeof(*all), cmp_ull);
+	print_result(t, path, status, ops, calls,
+		     calls ? (end - start) / 1e9 : 0, all);
+
+	pthread_barrier_destroy(&shared->barrier);
+	free(all);
+	munmap(lat, lat_size);
+	munmap(shared, size);
+
+	return 0;
+}
+
+static bool listed(char *list, const char *name) {
+	char *p;
+	size_t len = strlen(name);
+
+	if (!list)
+		return true;
+
+	for (p = list; *p; p += strcspn(p, ","), p += *p == ',')
+		if (!strncmp(p, name, len) && (p[len] == ',' || !p[len]))
+			return true;
+
+	return false;
+}
+
+static void usage(const char *prog) {
+	printf("usage: %s [options]\n"
+	       "  -d dev      driver node (default /dev/fwdt)\n"
+	       "  -s          use the simulated devices of libfwdtsim\n"
+	       "  -l ns       simulated latency per access (with -s)\n"
+	       "  -n calls    calls per worker (default 10000)\n"
+	       "  -b ops      accesses per batch, range, ring or mmap call "
+	       "(default 64, max %d)\n"
+	       "  -t n        run n threads\n"
+	       "  -p n        run n processes\n"
+	       "  -f fmt      text, csv or json\n"
+	       "  -T list     targets: io,mem,cmos,pci,ec,msr,acpi\n"
+	       "  -P list     paths: sysfs,ioctl,batch,range,ring,mmap\n"
+	       "  -a t=addr   address for target t, e.g. cmos=0x20\n"
+	       "  -D t=dev    PCI function (bus:dev.fn) or MSR cpu\n"
+	       "  -A path     LCD device whose _BQC is evaluated "
+	       "(default %s)\n"
+	       "mem is only measured with -a mem=addr unless -s is given.\n",
+	       prog, MAX_BULK, DEFAULT_LCD);
+}
+
+static struct bench_target *find_target(const char *name, size_t len) {
+	int i;
+
+	for (i = 0; i < NUM_TARGETS; i++)
+		if (strlen(targets[i].name) == len &&
+		    !strncmp(targets[i].name, name, len))
+			return &targets[i];
+
+	return NULL;
+}
+
+static int parse_target_arg(char *arg, bool device) {
+	struct bench_target *t;
+	char *eq = strchr(arg, '=');
+	unsigned int bus, dev, fn;
+
+	if (!eq || !(t = find_target(arg, eq - arg)))
+		return FWDT_FAIL;
+
+	if (!device) {
+		t->address = strtoull(eq + 1, NULL, 0);
+		if (t->target == FWDT_TARGET_MEMORY)
+			opt.mem_address = true;
+	} else if (t->target == FWDT_TARGET_PCI) {
+		if (sscanf(eq + 1, "%x:%x.%x", &bus, &dev, &fn) != 3)
+			return FWDT_FAIL;
+		t->device = FWDT_PCI_DEVICE(0, bus, dev, fn);
+	} else {
+		t->device = strtoul(eq + 1, NULL, 0);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int c, i, p;
+
+	while ((c = getopt(argc, argv, "d:sl:n:b:t:p:f:T:P:a:D:A:h")) != -1) {
+		switch (c) {
+		case 'd':
+			opt.device = optarg;
+			break;
+		case 's':
+			opt.sim = true;
+			break;
+		case 'l':
+			opt.latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt.calls = atoi(optarg);
+			break;
+		case 'b':
+			opt.bulk = atoi(optarg);
+			break;
+		case 't':
+		case 'p':
+			opt.workers = atoi(optarg);
+			opt.processes = c == 'p';
+			break;
+		case 'f':
+			if (!strcmp(optarg, "csv"))
+				opt.format = FORMAT_CSV;
+			else if (!strcmp(optarg, "json"))
+				opt.format = FORMAT_JSON;
+			else if (!strcmp(optarg, "text"))
+				opt.format = FORMAT_TEXT;
+			else
+				goto usage;
+			break;
+		case 'T':
+			opt.targets = optarg;
+			break;
+		case 'P':
+			opt.paths = optarg;
+			break;
+		case 'a':
+		case 'D':
+			if (parse_target_arg(optarg, c == 'D'))
+				goto usage;
+			break;
+		case 'A':
+			snprintf(opt.lcd, sizeof(opt.lcd), "%s", optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (opt.calls < 1 || opt.workers < 1 || opt.bulk < 1 ||
+	    opt.bulk > MAX_BULK || opt.lcd[0] != '\\')
+		goto usage;
+
+	if (opt.sim) {
+		snprintf(opt.lcd, sizeof(opt.lcd), "%s", FWDT_SIM_LCD_PATH);
+		for (i = FWDT_TARGET_IO; i <= FWDT_TARGET_ACPI; i++)
+			fwdt_sim_set_latency(i, opt.latency);
+	} else if (access(opt.device, R_OK | W_OK)) {
+		printf("Cannot open fwdt driver. Aborted.\n");
+		return FWDT_FAIL;
+	}
+
+	print_header();
+	for (i = 0; i < NUM_TARGETS; i++) {
+		if (!listed(opt.targets, targets[i].name))
+			continue;
+		if (targets[i].target == FWDT_TARGET_MEMORY &&
+		    !opt.mem_address && !opt.sim)
+			continue;
+		for (p = 0; p < NUM_PATHS; p++) {
+			if (!(targets[i].paths & (1 << p)) ||
+			    !listed(opt.paths, path_names[p]))
+				continue;
+			if (opt.sim && !(sim_paths[i] & (1 << p)))
+				continue;
+			if (bench_one(&targets[i], p))
+				return FWDT_FAIL;
+		}
+	}
+	print_footer();
+
+	return 0;
+
+ usage:
+	usage(argv[0]);
+	return FWDT_FAIL;
+}
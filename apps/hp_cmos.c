@@ -6,19 +6,19 @@
 #include "fwdtapp.h"
 #include "fwdt.h"
 
-int get_cmos_register(int fd, u8 addr, u8* val) {
-	int err;
+int get_cmos_range(int fd, u8 addr, u8* val, int len) {
 	long ioret;
-	struct fwdt_cmos_data fc;
+	struct fwdt_cmos_range fc;
 
-	fc.parameters.func = GET_DATA_BYTE;
-	fc.cmos_address = addr;
+	fc.parameters.func = READ_CMOS_RANGE;
+	fc.offset = addr;
+	fc.length = len;
 
-	ioret = ioctl(fd, FWDT_HW_ACCESS_CMOS_CMD, &fc);
-	if (ioret)
+	ioret = ioctl(fd, FWDT_CMOS_RANGE_CMD, &fc);
+	if (ioret || fc.parameters.func_status != FWDT_SUCCESS)
 		return FWDT_FAIL;
 
-	*val = fc.cmos_data;
+	memcpy(val, fc.data, len);
 
 	return 0;
 }
@@ -26,7 +26,7 @@ int get_cmos_register(int fd, u8 addr, u8* val) {
 int main(void) {
 	int err;
 	int fd;
-	u8 cmos_data;
+	u8 cmos_data[4];
 	int i;
 
 	err = 0;
@@ -38,10 +38,9 @@ int main(void) {
 	}
 
 	printf("hp laptop debugging info:\n");
-	for (i = 0x70; i < 0x74; i++) {
-		err = get_cmos_register(fd, i, &cmos_data);
-		printf("\tCMOS register 0x%02x = 0x%02x\n", i, cmos_data);
-	}
+	err = get_cmos_range(fd, 0x70, cmos_data, sizeof(cmos_data));
+	for (i = 0; i < sizeof(cmos_data); i++)
+		printf("\tCMOS register 0x%02x = 0x%02x\n", 0x70 + i, cmos_data[i]);
 
 	close(fd);
 
@@ -16,6 +16,23 @@ enum fwdt_hw_access_sub_cmd {
 	SET_DATA_WORD		=	0x04,
 	GET_DATA_DWORD		= 	0x05,
 	SET_DATA_DWORD		= 	0x06,
+	GET_DATA_QWORD		=	0x07,
+	SET_DATA_QWORD		=	0x08,
+};
+
+enum fwdt_batch_sub_cmd {
+	RUN_BATCH		=	0x01,
+	RUN_BATCH_STOP_ON_ERROR	=	0x02,
+};
+
+enum fwdt_batch_target {
+	FWDT_TARGET_IO		=	0x01,
+	FWDT_TARGET_MEMORY	=	0x02,
+	FWDT_TARGET_CMOS	=	0x03,
+	FWDT_TARGET_PCI		=	0x04,
+	FWDT_TARGET_EC		=	0x05,
+	FWDT_TARGET_MSR		=	0x06,
+	FWDT_TARGET_ACPI	=	0x07,	/* submission rings only */
 };
 
 typedef struct {
@@ -62,6 +79,457 @@ struct fwdt_cmos_data {
 	u8		cmos_data;
 } __attribute__ ((packed));
 
+/* PCI functions are addressed as segment:bus:device.function */
+#define FWDT_PCI_DEVICE(seg, bus, dev, fn) \
+	((((seg) & 0xFFFF) << 16) | (((bus) & 0xFF) << 8) | \
+	 (((dev) & 0x1F) << 3) | ((fn) & 0x07))
+
+struct fwdt_batch_op {
+	u16		func;		/* GET/SET_DATA_* */
+	u16		target;		/* FWDT_TARGET_* */
+	u32		device;		/* PCI: FWDT_PCI_DEVICE(), MSR: cpu */
+	u64		address;
+	u64		data;		/* value to write for SET_DATA_* */
+} __attribute__ ((packed));
+
+struct fwdt_batch_result {
+	int		status;
+	u32		reserved;
+	u64		data;
+} __attribute__ ((packed));
+
+#define FWDT_BATCH_MAX_OPS	4096
+
+struct fwdt_batch {
+	fwdt_parameter	parameters;
+	u32		num_ops;
+	u32		num_done;
+	u64		ops;		/* struct fwdt_batch_op[num_ops] */
+	u64		results;	/* struct fwdt_batch_result[num_ops] */
+} __attribute__ ((packed));
+
+enum fwdt_mmap_sub_cmd {
+	ADD_MMAP_WINDOW		=	0x01,
+	DEL_MMAP_WINDOW		=	0x02,
+	CLEAR_MMAP_WINDOWS	=	0x03,
+};
+
+#define FWDT_MMAP_MAX_WINDOWS	16
+
+/*
+ * mmap() of /dev/fwdt maps the physical range starting at the file
+ * offset uncached; the whole range must fall within one window.
+ */
+struct fwdt_mmap_window {
+	fwdt_parameter	parameters;
+	u64		base;
+	u64		size;
+} __attribute__ ((packed));
+
+enum fwdt_iomap_cache_sub_cmd {
+	GET_IOMAP_STATS		=	0x01,
+	FLUSH_IOMAP_CACHE	=	0x02,
+};
+
+struct fwdt_iomap_cache {
+	fwdt_parameter	parameters;
+	u32		entries;
+	u64		hits;
+	u64		misses;
+} __attribute__ ((packed));
+
+enum fwdt_pci_config_sub_cmd {
+	READ_PCI_CONFIG		=	0x01,
+	WRITE_PCI_CONFIG	=	0x02,
+};
+
+#define FWDT_PCI_CONFIG_SIZE	4096
+
+struct fwdt_pci_config {
+	fwdt_parameter	parameters;
+	u32		device;		/* FWDT_PCI_DEVICE() */
+	u16		offset;
+	u16		length;		/* offset + length <= 4096 */
+	u64		buffer;		/* u8[length] */
+} __attribute__ ((packed));
+
+enum fwdt_ec_range_sub_cmd {
+	READ_EC_RANGE		=	0x01,
+	WRITE_EC_RANGE		=	0x02,
+};
+
+struct fwdt_ec_range {
+	fwdt_parameter	parameters;
+	u16		offset;
+	u16		length;		/* offset + length <= 256 */
+	u8		data[256];
+} __attribute__ ((packed));
+
+enum fwdt_cmos_range_sub_cmd {
+	READ_CMOS_RANGE		=	0x01,
+	WRITE_CMOS_RANGE	=	0x02,
+};
+
+/* offsets 0x80-0xFF address the extended bank behind ports 0x72/0x73 */
+struct fwdt_cmos_range {
+	fwdt_parameter	parameters;
+	u16		offset;
+	u16		length;		/* offset + length <= 256 */
+	u8		data[256];
+} __attribute__ ((packed));
+
+enum fwdt_msr_matrix_sub_cmd {
+	READ_MSR_MATRIX		=	0x01,
+	WRITE_MSR_MATRIX	=	0x02,
+};
+
+#define FWDT_MSR_MAX_REGS	64
+
+/*
+ * values is a num_cpus x num_msrs matrix, one row per CPU. Only CPUs set
+ * in cpu_mask (u64 words, bit n is CPU n) are accessed; status[cpu] is
+ * FWDT_DEVICE_NOT_FOUND for the others and for offline CPUs.
+ */
+struct fwdt_msr_matrix {
+	fwdt_parameter	parameters;
+	u32		num_msrs;
+	u32		num_cpus;
+	u64		msrs;		/* u32[num_msrs] */
+	u64		cpu_mask;	/* u64[(num_cpus + 63) / 64] */
+	u64		values;		/* u64[num_cpus][num_msrs] */
+	u64		status;		/* int[num_cpus] */
+} __attribute__ ((packed));
+
+enum fwdt_msr_sampler_sub_cmd {
+	START_MSR_SAMPLER	=	0x01,
+	STOP_MSR_SAMPLER	=	0x02,
+};
+
+#define FWDT_SAMPLER_MAX_MSRS	8
+
+struct fwdt_msr_sample {
+	u64		tsc;
+	u32		cpu;
+	u32		num_msrs;
+	u64		values[FWDT_SAMPLER_MAX_MSRS];
+} __attribute__ ((packed));
+
+/*
+ * Once a sampler is started, read() on the same file returns whole
+ * fwdt_msr_sample records and mmap() maps num_rings rings, ring_bytes
+ * apart. A mapped consumer reads samples[tail % size] while tail != head
+ * and then advances tail; don't mix it with read(). After STOP_MSR_SAMPLER
+ * read() returns 0 and poll() POLLHUP once the rings are empty.
+ */
+struct fwdt_sample_ring {
+	u32		head;		/* advanced by the driver */
+	u32		tail;		/* advanced by the consumer */
+	u32		size;
+	u32		cpu;
+	u64		dropped;
+	u64		reserved;
+	struct fwdt_msr_sample samples[];
+} __attribute__ ((packed));
+
+struct fwdt_msr_sampler {
+	fwdt_parameter	parameters;
+	u32		num_msrs;
+	u32		msrs[FWDT_SAMPLER_MAX_MSRS];
+	u32		num_cpus;
+	u64		cpu_mask;	/* u64[(num_cpus + 63) / 64] */
+	u64		period_ns;
+	u32		ring_size;	/* samples per CPU, power of two */
+	u32		num_rings;	/* returned */
+	u32		ring_bytes;	/* returned */
+} __attribute__ ((packed));
+
+enum fwdt_io_range_sub_cmd {
+	READ_IO_RANGE		=	0x01,	/* consecutive ports */
+	WRITE_IO_RANGE		=	0x02,
+	READ_IO_FIFO		=	0x03,	/* same port, ins* */
+	WRITE_IO_FIFO		=	0x04,	/* same port, outs* */
+};
+
+#define FWDT_IO_RANGE_MAX	4096
+
+struct fwdt_io_range {
+	fwdt_parameter	parameters;
+	u16		io_address;
+	u8		width;		/* 1, 2 or 4 bytes per access */
+	u8		reserved;
+	u32		count;		/* count * width <= FWDT_IO_RANGE_MAX */
+	u64		buffer;		/* u8[count * width] */
+} __attribute__ ((packed));
+
+enum fwdt_ring_sub_cmd {
+	SETUP_RING		=	0x01,
+	ENTER_RING		=	0x02,
+	REGISTER_RING_METHOD	=	0x03,
+};
+
+#define FWDT_RING_MAX_ENTRIES	4096
+#define FWDT_RING_MAX_METHODS	16
+
+/* fwdt_ring.flags */
+#define FWDT_RING_SQPOLL	0x01	/* worker polls the SQ while busy */
+
+/* fwdt_ring_header.flags, set by the driver */
+#define FWDT_RING_NEED_WAKEUP	0x01	/* worker sleeps, ENTER_RING to kick */
+
+/*
+ * One access, as for the batch ops. For FWDT_TARGET_ACPI, device is an
+ * index returned by REGISTER_RING_METHOD, func GET_DATA_QWORD evaluates
+ * the method without arguments and SET_DATA_QWORD passes data as Arg0;
+ * an integer result is returned in data.
+ */
+struct fwdt_ring_sqe {
+	u16		func;
+	u16		target;
+	u32		device;
+	u64		address;
+	u64		data;
+	u64		user_data;	/* copied to the completion */
+} __attribute__ ((packed));
+
+struct fwdt_ring_cqe {
+	u64		user_data;
+	u64		data;
+	u64		timestamp;	/* CLOCK_MONOTONIC ns at completion */
+	int		status;
+	u32		reserved;
+} __attribute__ ((packed));
+
+/*
+ * Start of the area mmap()ed after SETUP_RING; the SQE and CQE arrays
+ * follow at sq_offset and cq_offset. The submitter fills
+ * sqes[sq_tail % sq_entries] and advances sq_tail, the worker consumes
+ * up to it and advances sq_head. Completions are read from
+ * cqes[cq_head % cq_entries] while cq_head != cq_tail, then cq_head is
+ * advanced. The worker stops taking SQEs while the CQ is full and
+ * sleeps when idle; whenever FWDT_RING_NEED_WAKEUP is set in flags, new
+ * SQEs or freed CQ slots need an ENTER_RING to be noticed.
+ */
+struct fwdt_ring_header {
+	u32		sq_head;	/* advanced by the driver */
+	u32		sq_tail;	/* advanced by the submitter */
+	u32		sq_entries;
+	u32		cq_head;	/* advanced by the consumer */
+	u32		cq_tail;	/* advanced by the driver */
+	u32		cq_entries;
+	u32		flags;		/* FWDT_RING_NEED_WAKEUP */
+	u32		reserved;
+	u64		sq_offset;
+	u64		cq_offset;
+} __attribute__ ((packed));
+
+struct fwdt_ring {
+	fwdt_parameter	parameters;
+	u32		sq_entries;	/* SETUP_RING, power of two */
+	u32		cq_entries;	/* SETUP_RING, power of two */
+	u32		flags;		/* SETUP_RING, FWDT_RING_SQPOLL */
+	u32		idle_ms;	/* SETUP_RING, SQPOLL spin before sleeping */
+	u32		ring_bytes;	/* SETUP_RING, returned */
+	u32		min_complete;	/* ENTER_RING, completions to wait for */
+	u32		method;		/* REGISTER_RING_METHOD, returned */
+	char		path[256];	/* REGISTER_RING_METHOD */
+} __attribute__ ((packed));
+
+enum fwdt_watch_sub_cmd {
+	ADD_WATCH		=	0x01,
+	DEL_WATCH		=	0x02,
+	CLEAR_WATCHES		=	0x03,
+};
+
+enum fwdt_watch_mode {
+	WATCH_ANY_CHANGE	=	0x01,	/* (value & mask) changed */
+	WATCH_EQUAL		=	0x02,	/* (value & mask) became value */
+};
+
+#define FWDT_WATCH_MAX		64	/* per open file */
+#define FWDT_WATCH_MIN_INTERVAL_MS	1
+
+/*
+ * A register polled by the driver every interval_ms. The access is
+ * described as for the batch ops with a GET_DATA_* func; the first
+ * poll only records the initial value.
+ */
+struct fwdt_watch {
+	fwdt_parameter	parameters;
+	u32		id;		/* returned by ADD_WATCH */
+	u16		func;
+	u16		target;
+	u32		device;
+	u64		address;
+	u64		mask;
+	u64		value;		/* WATCH_EQUAL */
+	u32		mode;
+	u32		interval_ms;
+} __attribute__ ((packed));
+
+/* read() from a file with watches returns these; poll() waits for one */
+struct fwdt_watch_event {
+	u32		id;
+	u32		reserved;
+	u64		old_value;	/* masked */
+	u64		new_value;	/* masked */
+	u64		timestamp;	/* CLOCK_MONOTONIC ns */
+} __attribute__ ((packed));
+
+enum fwdt_acpi_event_sub_cmd {
+	START_ACPI_EVENTS	=	0x01,
+	STOP_ACPI_EVENTS	=	0x02,
+	ADD_ACPI_EVENT_DEVICE	=	0x03,
+	DEL_ACPI_EVENT_DEVICE	=	0x04,
+};
+
+enum fwdt_acpi_event_type {
+	FWDT_ACPI_EVENT_NOTIFY	=	0x01,	/* value is the notify code */
+	FWDT_ACPI_EVENT_EC_QMETHOD =	0x02,	/* value is the query number */
+};
+
+/*
+ * FWDT_ACPI_EVENT_EC_QMETHOD is raised for _Qxx methods run through the
+ * ec_qmethod sysfs file. GPE dispatch and the queries the EC driver runs
+ * for real SCIs are not captured, only the Notify()s they lead to.
+ */
+
+/* fwdt_acpi_events.flags for START_ACPI_EVENTS */
+#define FWDT_ACPI_EVENT_ALL_DEVICES	0x01	/* device notifies (>= 0x80) */
+
+#define FWDT_ACPI_EVENT_DEVICES	16
+#define FWDT_ACPI_EVENT_NO_EC_GPE	0xFFFFFFFF
+
+/*
+ * read() on the file that started the capture returns these; poll()
+ * waits for one. ec_gpe is the EC's _GPE for events from the EC device,
+ * not a record of which GPE fired.
+ */
+struct fwdt_acpi_event {
+	u64		timestamp;	/* CLOCK_MONOTONIC ns */
+	u32		type;
+	u32		value;
+	u32		ec_gpe;
+	u32		reserved;
+	char		path[64];
+} __attribute__ ((packed));
+
+struct fwdt_acpi_events {
+	fwdt_parameter	parameters;
+	u32		flags;
+	u32		reserved;
+	u64		dropped;	/* returned, events lost since START */
+	char		path[256];	/* ADD/DEL_ACPI_EVENT_DEVICE */
+} __attribute__ ((packed));
+
+enum fwdt_acpi_eval_sub_cmd {
+	EVALUATE_ACPI_METHOD	=	0x01,
+};
+
+/* same values as ACPI object types where they exist */
+enum fwdt_acpi_object_type {
+	FWDT_ACPI_INTEGER	=	0x01,	/* u64 */
+	FWDT_ACPI_STRING	=	0x02,	/* length bytes, no NUL */
+	FWDT_ACPI_BUFFER	=	0x03,	/* length bytes */
+	FWDT_ACPI_PACKAGE	=	0x04,	/* length elements follow */
+	FWDT_ACPI_REFERENCE	=	0x14,	/* length bytes of path, result only */
+};
+
+#define FWDT_ACPI_EVAL_MAX_ARGS		8
+#define FWDT_ACPI_EVAL_MAX_SIZE		65536
+#define FWDT_ACPI_EVAL_MAX_DEPTH	8
+
+/*
+ * Arguments and results are a sequence of objects, each a header
+ * followed by its payload; a package is followed by its elements.
+ * Result objects of other types carry no payload.
+ */
+struct fwdt_acpi_object_hdr {
+	u16		type;
+	u16		reserved;
+	u32		length;
+} __attribute__ ((packed));
+
+struct fwdt_acpi_eval {
+	fwdt_parameter	parameters;
+	char		path[256];	/* method, e.g. \_SB.WMI1.WMAA */
+	u32		num_args;
+	u32		args_size;
+	u64		args;		/* num_args objects */
+	u32		result_size;	/* buffer size in, encoded size out */
+	u32		acpi_status;	/* returned */
+	u64		result;		/* at most one object */
+} __attribute__ ((packed));
+
+enum fwdt_session_sub_cmd {
+	SELECT_SESSION_TARGET	=	0x01,
+	CLEAR_SESSION_TARGET	=	0x02,
+};
+
+/*
+ * Once a target is selected, read() and write() on the same file access
+ * it with the file position as the address, which lseek() moves within
+ * the target; pread()/pwrite() address it directly. IO and memory move
+ * width bytes per access at width-aligned positions. CMOS, EC and PCI
+ * config are byte addressed. For MSRs the position is the MSR number and
+ * each register moves 8 bytes.
+ */
+struct fwdt_session {
+	fwdt_parameter	parameters;
+	u16		target;		/* FWDT_TARGET_*, except ACPI */
+	u8		width;		/* IO and memory: 1, 2 or 4 */
+	u8		reserved;
+	u32		device;		/* PCI: FWDT_PCI_DEVICE(), MSR: cpu */
+} __attribute__ ((packed));
+
+enum fwdt_mem_scan_sub_cmd {
+	ADD_SCAN_RANGE		=	0x01,
+	DEL_SCAN_RANGE		=	0x02,
+	CLEAR_SCAN_RANGES	=	0x03,
+	RUN_SCAN		=	0x04,
+};
+
+#define FWDT_SCAN_MAX_RANGES	16		/* per open file */
+#define FWDT_SCAN_MAX_SIZE	(64 << 20)	/* per range */
+#define FWDT_SCAN_MIN_BLOCK	64
+
+/*
+ * A physical range hashed per block by the driver. ADD_SCAN_RANGE takes
+ * the baseline; each RUN_SCAN then fills buffer with a fwdt_scan_record
+ * and the new contents for every block of every range that changed since
+ * it was last reported. block_size is a power of two from
+ * FWDT_SCAN_MIN_BLOCK to the page size and size a multiple of it.
+ */
+struct fwdt_mem_scan {
+	fwdt_parameter	parameters;
+	u32		id;		/* returned by ADD_SCAN_RANGE */
+	u32		block_size;
+	u64		address;
+	u64		size;
+	u64		buffer;		/* RUN_SCAN: u8[buffer_size] */
+	u32		buffer_size;
+	u32		bytes;		/* RUN_SCAN, returned */
+	u32		changed;	/* RUN_SCAN, blocks returned */
+	u32		pending;	/* RUN_SCAN, changed blocks left over */
+} __attribute__ ((packed));
+
+/* blocks that did not fit stay pending and are returned by the next scan */
+struct fwdt_scan_record {
+	u32		id;
+	u32		size;
+	u64		offset;		/* from the start of the range */
+} __attribute__ ((packed));
+
+/*
+ * Records streamed from debugfs fwdt/pci_snapshot (every function) and
+ * fwdt/pci_snapshot_diff (functions changed since the previous diff read),
+ * each followed by size bytes of config space.
+ */
+struct fwdt_pci_record {
+	u32		device;		/* FWDT_PCI_DEVICE() */
+	u16		size;
+	u16		reserved;
+} __attribute__ ((packed));
+
 typedef struct {
 	fwdt_parameter	parameters;
 } fwdt_generic;
@@ -79,4 +547,49 @@ typedef struct {
 #define FWDT_HW_ACCESS_CMOS_CMD \
         _IOWR('p', 0x04, struct fwdt_cmos_data)
 
+#define FWDT_BATCH_CMD \
+        _IOWR('p', 0x05, struct fwdt_batch)
+
+#define FWDT_MMAP_WINDOW_CMD \
+        _IOWR('p', 0x06, struct fwdt_mmap_window)
+
+#define FWDT_IOMAP_CACHE_CMD \
+        _IOWR('p', 0x07, struct fwdt_iomap_cache)
+
+#define FWDT_PCI_CONFIG_CMD \
+        _IOWR('p', 0x08, struct fwdt_pci_config)
+
+#define FWDT_EC_RANGE_CMD \
+        _IOWR('p', 0x09, struct fwdt_ec_range)
+
+#define FWDT_CMOS_RANGE_CMD \
+        _IOWR('p', 0x0A, struct fwdt_cmos_range)
+
+#define FWDT_MSR_MATRIX_CMD \
+        _IOWR('p', 0x0B, struct fwdt_msr_matrix)
+
+#define FWDT_MSR_SAMPLER_CMD \
+        _IOWR('p', 0x0C, struct fwdt_msr_sampler)
+
+#define FWDT_IO_RANGE_CMD \
+        _IOWR('p', 0x0D, struct fwdt_io_range)
+
+#define FWDT_RING_CMD \
+        _IOWR('p', 0x0E, struct fwdt_ring)
+
+#define FWDT_WATCH_CMD \
+        _IOWR('p', 0x0F, struct fwdt_watch)
+
+#define FWDT_ACPI_EVENT_CMD \
+        _IOWR('p', 0x10, struct fwdt_acpi_events)
+
+#define FWDT_ACPI_EVAL_CMD \
+        _IOWR('p', 0x11, struct fwdt_acpi_eval)
+
+#define FWDT_SESSION_CMD \
+        _IOWR('p', 0x12, struct fwdt_session)
+
+#define FWDT_MEM_SCAN_CMD \
+        _IOWR('p', 0x13, struct fwdt_mem_scan)
+
 #endif
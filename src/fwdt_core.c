@@ -0,0 +1,531 @@
+/*
+ * FWDT command dispatch
+ *
+ * Copyright(C) 2012 Canonical Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The ioctl handlers that only need the hardware accessors live here, so
+ * they build both into the driver and, against fwdt_user.h and the
+ * simulated devices in fwdt_sim.c, into a userspace library.
+ */
+
+#define pr_fmt(fmt) "fwdt: " fmt
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/timex.h>
+#include <linux/uaccess.h>
+
+#include "fwdt.h"
+#include "fwdt_trace.h"
+#else
+#include "fwdt_user.h"
+#endif
+
+#include "fwdt_core.h"
+
+static int get_acpi_vga_brightness(const struct fwdt_backend *b,
+				   struct fwdt_brightness *fb)
+{
+	int status;
+	u64 bqc_level = 0;
+	void *lcd_device;
+	cycles_t start;
+
+	status = b->acpi_lookup(fb->lcd_path, &lcd_device);
+	if (status) {
+		pr_info("Failed to find acpi lcd device: %s\n", fb->lcd_path);
+		fb->parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		goto err;
+	}
+
+	start = get_cycles();
+	status = b->acpi_integer(lcd_device, fb->lcd_path, "_BQC", NULL,
+				 &bqc_level);
+	trace_fwdt_brightness(fb->lcd_path, GET_BRIGHTNESS, bqc_level,
+			      status ? FWDT_FAIL : FWDT_SUCCESS,
+			      get_cycles() - start);
+	if (status) {
+		pr_info("Failed to read brightness level!\n");
+		fb->parameters.func_status = FWDT_FAIL;
+		goto err;
+	}
+
+	fb->brightness_level = bqc_level;
+	fb->parameters.func_status = FWDT_SUCCESS;
+ err:
+	return status;
+}
+
+static int set_acpi_vga_brightness(const struct fwdt_backend *b,
+				   struct fwdt_brightness *fb)
+{
+	int status;
+	u64 level = fb->brightness_level;
+	void *lcd_device;
+	cycles_t start;
+
+	status = b->acpi_lookup(fb->lcd_path, &lcd_device);
+	if (status) {
+		pr_info("Failed to find acpi lcd device: %s\n", fb->lcd_path);
+		fb->parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		goto err;
+	}
+
+	start = get_cycles();
+	status = b->acpi_integer(lcd_device, fb->lcd_path, "_BCM", &level,
+				 NULL);
+	trace_fwdt_brightness(fb->lcd_path, SET_BRIGHTNESS,
+			      fb->brightness_level,
+			      status ? FWDT_FAIL : FWDT_SUCCESS,
+			      get_cycles() - start);
+	if (status) {
+		pr_info("Failed to set brightness level!\n");
+		fb->parameters.func_status = FWDT_FAIL;
+		goto err;
+	}
+
+	fb->parameters.func_status = FWDT_SUCCESS;
+ err:
+	return status;
+}
+
+static int get_acpi_vga_br_levels(const struct fwdt_backend *b,
+				  struct fwdt_brightness *fbl)
+{
+	int status;
+	void *lcd_device;
+	u32 num_of_levels = 0;
+	u32 *levels = NULL;
+	cycles_t start;
+
+	status = b->acpi_lookup(fbl->lcd_path, &lcd_device);
+	if (status) {
+		pr_info("Failed to find acpi lcd device: %s\n", fbl->lcd_path);
+		fbl->parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		goto err;
+	}
+
+	/* fbl is packed, so the backend fills an aligned copy */
+	levels = kmalloc(sizeof(fbl->levels), GFP_KERNEL);
+	if (!levels) {
+		status = -ENOMEM;
+		fbl->parameters.func_status = FWDT_FAIL;
+		goto err;
+	}
+
+	start = get_cycles();
+	status = b->br_levels(lcd_device, levels, &num_of_levels);
+	trace_fwdt_brightness(fbl->lcd_path, GET_BRIGHTNESS_LV, num_of_levels,
+			      status ? FWDT_FAIL : FWDT_SUCCESS,
+			      get_cycles() - start);
+	if (status) {
+		printk("Failed to query brightness levels\n");
+		fbl->parameters.func_status = FWDT_FAIL;
+		goto err;
+	}
+
+	memcpy(fbl->levels, levels, sizeof(fbl->levels));
+	fbl->num_of_levels = num_of_levels;
+	fbl->parameters.func_status = FWDT_SUCCESS;
+ err:
+	kfree(levels);
+	return status;
+}
+
+static int handle_acpi_vga_cmd(const struct fwdt_backend *b,
+			       fwdt_generic __user *fg)
+{
+	int err;
+
+	switch (fg->parameters.func) {
+	case GET_BRIGHTNESS:
+		err = get_acpi_vga_brightness(b, (struct fwdt_brightness*) fg);
+		break;
+	case SET_BRIGHTNESS:
+		err = set_acpi_vga_brightness(b, (struct fwdt_brightness*) fg);
+		break;
+	case GET_BRIGHTNESS_LV:
+		err = get_acpi_vga_br_levels(b, (struct fwdt_brightness*) fg);
+		break;
+/*
+	case GET_VIDEO_DEVICE:
+		break;
+*/
+	default:
+		err = FWDT_FUNC_NOT_SUPPORTED;
+		break;
+	}
+
+	return err;
+}
+
+static int handle_hardware_io_cmd(const struct fwdt_backend *b,
+				  fwdt_generic __user *fg)
+{
+	int ret = 0;
+	u16 func = fg->parameters.func;
+	u64 data;
+	struct fwdt_io_data *fid = (struct fwdt_io_data*) fg;
+
+	switch (func) {
+	case GET_DATA_BYTE:
+	case GET_DATA_WORD:
+		b->io(func, fid->io_address, &data);
+		if (func == GET_DATA_BYTE)
+			fid->io_byte = data;
+		else
+			fid->io_word = data;
+		break;
+	case SET_DATA_BYTE:
+	case SET_DATA_WORD:
+		data = func == SET_DATA_BYTE ? fid->io_byte : fid->io_word;
+		b->io(func, fid->io_address, &data);
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+		break;
+	}
+
+	fid->parameters.func_status = FWDT_SUCCESS;
+ err:
+	return ret;
+}
+
+static int handle_hardware_memory_cmd(const struct fwdt_backend *b,
+				      fwdt_generic __user *fg)
+{
+	int ret;
+	u64 data;
+	struct fwdt_mem_data *fmd = (struct fwdt_mem_data*) fg;
+
+	data = fmd->mem_data;
+	ret = b->mem(fg->parameters.func, fmd->mem_address, &data);
+	if (ret)
+		goto err;
+
+	fmd->mem_data = data;
+	fmd->parameters.func_status = FWDT_SUCCESS;
+ err:
+	return ret;
+}
+
+static int handle_hardware_cmos_cmd(const struct fwdt_backend *b,
+				    fwdt_generic __user *fg)
+{
+	int ret = 0;
+	u8 data;
+	struct fwdt_cmos_data *fcd = (struct fwdt_cmos_data*) fg;
+
+	switch (fg->parameters.func) {
+	case GET_DATA_BYTE:
+		b->cmos_range(READ_CMOS_RANGE, fcd->cmos_address, &data, 1);
+		fcd->cmos_data = data;
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+		break;
+	}
+
+	fcd->parameters.func_status = FWDT_SUCCESS;
+ err:
+	return ret;
+}
+
+int fwdt_core_run_op(const struct fwdt_backend *b, struct fwdt_batch_op *op,
+		     struct fwdt_batch_result *res)
+{
+	u64 data = op->data;
+	int status;
+
+	switch (op->target) {
+	case FWDT_TARGET_IO:
+		status = b->io(op->func, op->address, &data);
+		break;
+	case FWDT_TARGET_MEMORY:
+		status = b->mem(op->func, op->address, &data);
+		break;
+	case FWDT_TARGET_CMOS:
+		status = b->cmos(op->func, op->address, &data);
+		break;
+	case FWDT_TARGET_PCI:
+		status = b->pci(op->func, op->device, op->address, &data);
+		break;
+	case FWDT_TARGET_EC:
+		status = b->ec(op->func, op->address, &data);
+		break;
+	case FWDT_TARGET_MSR:
+		status = b->msr(op->func, op->device, op->address, &data);
+		break;
+	default:
+		status = FWDT_FUNC_NOT_SUPPORTED;
+		break;
+	}
+
+	res->status = status;
+	res->reserved = 0;
+	res->data = data;
+
+	return status;
+}
+
+/* ops and results are staged through the kernel this many at a time */
+#define FWDT_BATCH_CHUNK	128
+
+static int handle_batch_cmd(const struct fwdt_backend *b,
+			    fwdt_generic __user *fg)
+{
+	struct fwdt_batch fb;
+	struct fwdt_batch_op *ops;
+	struct fwdt_batch_result *results;
+	struct fwdt_batch_op __user *uops;
+	struct fwdt_batch_result __user *uresults;
+	u32 done, n, i;
+	bool stop = false;
+	int ret = 0;
+	u16 func;
+
+	if (copy_from_user(&fb, fg, sizeof(fb)))
+		return -EFAULT;
+
+	func = fb.parameters.func;
+	if (func != RUN_BATCH && func != RUN_BATCH_STOP_ON_ERROR)
+		return FWDT_FUNC_NOT_SUPPORTED;
+
+	if (fb.num_ops > FWDT_BATCH_MAX_OPS)
+		return -EINVAL;
+
+	uops = (struct fwdt_batch_op __user *) (unsigned long) fb.ops;
+	uresults = (struct fwdt_batch_result __user *) (unsigned long) fb.results;
+
+	ops = kmalloc(FWDT_BATCH_CHUNK * sizeof(*ops), GFP_KERNEL);
+	results = kmalloc(FWDT_BATCH_CHUNK * sizeof(*results), GFP_KERNEL);
+	if (!ops || !results) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	fb.parameters.func_status = FWDT_SUCCESS;
+	for (done = 0; done < fb.num_ops && !stop; done += n) {
+		n = min_t(u32, fb.num_ops - done, FWDT_BATCH_CHUNK);
+		if (copy_from_user(ops, uops + done, n * sizeof(*ops))) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (fwdt_core_run_op(b, &ops[i], &results[i]) ==
+			    FWDT_SUCCESS)
+				continue;
+			fb.parameters.func_status = FWDT_FAIL;
+			if (func == RUN_BATCH_STOP_ON_ERROR) {
+				stop = true;
+				n = i + 1;
+				break;
+			}
+		}
+
+		if (copy_to_user(uresults + done, results, n * sizeof(*results))) {
+			ret = -EFAULT;
+			goto out;
+		}
+	}
+
+	fb.num_done = done;
+	if (copy_to_user(fg, &fb, sizeof(fb)))
+		ret = -EFAULT;
+ out:
+	kfree(results);
+	kfree(ops);
+	return ret;
+}
+
+static int handle_ec_range_cmd(const struct fwdt_backend *b,
+			       fwdt_generic __user *fg)
+{
+	struct fwdt_ec_range *fer;
+	u16 func;
+	int ret = 0;
+
+	fer = kmalloc(sizeof(*fer), GFP_KERNEL);
+	if (!fer)
+		return -ENOMEM;
+
+	if (copy_from_user(fer, fg, sizeof(*fer))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	func = fer->parameters.func;
+	if (func != READ_EC_RANGE && func != WRITE_EC_RANGE) {
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto out;
+	}
+
+	switch (b->ec_range(func, fer->offset, fer->data, fer->length)) {
+	case 0:
+		fer->parameters.func_status = FWDT_SUCCESS;
+		break;
+	case -ENODEV:
+		fer->parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		break;
+	default:
+		fer->parameters.func_status = FWDT_FAIL;
+		break;
+	}
+
+	if (copy_to_user(fg, fer, sizeof(*fer)))
+		ret = -EFAULT;
+ out:
+	kfree(fer);
+	return ret;
+}
+
+static int handle_cmos_range_cmd(const struct fwdt_backend *b,
+				 fwdt_generic __user *fg)
+{
+	struct fwdt_cmos_range *fcr;
+	u16 func;
+	int ret = 0;
+
+	fcr = kmalloc(sizeof(*fcr), GFP_KERNEL);
+	if (!fcr)
+		return -ENOMEM;
+
+	if (copy_from_user(fcr, fg, sizeof(*fcr))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	func = fcr->parameters.func;
+	if (func != READ_CMOS_RANGE && func != WRITE_CMOS_RANGE) {
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto out;
+	}
+
+	if (b->cmos_range(func, fcr->offset, fcr->data, fcr->length))
+		fcr->parameters.func_status = FWDT_FAIL;
+	else
+		fcr->parameters.func_status = FWDT_SUCCESS;
+
+	if (copy_to_user(fg, fcr, sizeof(*fcr)))
+		ret = -EFAULT;
+ out:
+	kfree(fcr);
+	return ret;
+}
+
+static int handle_io_range_cmd(const struct fwdt_backend *b,
+			       fwdt_generic __user *fg)
+{
+	struct fwdt_io_range fir;
+	void __user *ubuf;
+	size_t size;
+	void *buf;
+	u16 func;
+	int ret = 0;
+
+	if (copy_from_user(&fir, fg, sizeof(fir)))
+		return -EFAULT;
+
+	func = fir.parameters.func;
+	if (func != READ_IO_RANGE && func != WRITE_IO_RANGE &&
+	    func != READ_IO_FIFO && func != WRITE_IO_FIFO)
+		return FWDT_FUNC_NOT_SUPPORTED;
+
+	if (fir.width != 1 && fir.width != 2 && fir.width != 4)
+		return -EINVAL;
+
+	size = (size_t) fir.count * fir.width;
+	if (!fir.count || size > FWDT_IO_RANGE_MAX)
+		return -EINVAL;
+
+	/* consecutive ports must not run past the end of the IO space */
+	if ((func == READ_IO_RANGE || func == WRITE_IO_RANGE) &&
+	    fir.io_address + size > 0x10000)
+		return -EINVAL;
+
+	ubuf = (void __user *) (unsigned long) fir.buffer;
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if ((func == WRITE_IO_RANGE || func == WRITE_IO_FIFO) &&
+	    copy_from_user(buf, ubuf, size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	b->io_range(func, fir.io_address, fir.width, buf, fir.count);
+
+	if ((func == READ_IO_RANGE || func == READ_IO_FIFO) &&
+	    copy_to_user(ubuf, buf, size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	fir.parameters.func_status = FWDT_SUCCESS;
+	if (copy_to_user(fg, &fir, sizeof(fir)))
+		ret = -EFAULT;
+ out:
+	kfree(buf);
+	return ret;
+}
+
+long fwdt_core_ioctl(const struct fwdt_backend *b, unsigned int cmd,
+		     unsigned long arg)
+{
+	fwdt_generic __user *fg = (fwdt_generic __user *) arg;
+	int err;
+
+	switch (cmd) {
+	case FWDT_ACPI_VGA_CMD:
+		err = handle_acpi_vga_cmd(b, fg);
+		break;
+	case FWDT_HW_ACCESS_IO_CMD:
+		err = handle_hardware_io_cmd(b, fg);
+		break;
+	case FWDT_HW_ACCESS_MEMORY_CMD:
+		err = handle_hardware_memory_cmd(b, fg);
+		break;
+	case FWDT_HW_ACCESS_CMOS_CMD:
+		err = handle_hardware_cmos_cmd(b, fg);
+		break;
+	case FWDT_BATCH_CMD:
+		err = handle_batch_cmd(b, fg);
+		break;
+	case FWDT_EC_RANGE_CMD:
+		err = handle_ec_range_cmd(b, fg);
+		break;
+	case FWDT_CMOS_RANGE_CMD:
+		err = handle_cmos_range_cmd(b, fg);
+		break;
+	case FWDT_IO_RANGE_CMD:
+		err = handle_io_range_cmd(b, fg);
+		break;
+	default:
+		err = -ENOIOCTLCMD;
+		break;
+	}
+
+	return err;
+}
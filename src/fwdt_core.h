@@ -0,0 +1,39 @@
+#ifndef __FWDT_CORE_H__
+#define __FWDT_CORE_H__
+
+/*
+ * Hardware behind the command dispatch in fwdt_core.c.  The driver fills
+ * this in with the real accessors, and fwdt_sim.c with in-memory devices so
+ * the same dispatch and batching code runs as a userspace library.
+ *
+ * Single accesses take GET_/SET_DATA_* and return FWDT_* status codes.
+ * Range accesses take the READ_/WRITE_*_RANGE (or _FIFO) sub commands and
+ * return 0 or a negative errno, -ENODEV when the device is absent.  The
+ * ACPI ops return 0 or a nonzero platform status (acpi_status in the
+ * kernel); acpi_integer passes a single integer argument when arg is set.
+ */
+struct fwdt_backend {
+	int (*io)(u16 func, u16 port, u64 *data);
+	void (*io_range)(u16 func, u16 port, u8 width, void *buf, u32 count);
+	int (*mem)(u16 func, u64 address, u64 *data);
+	int (*cmos)(u16 func, u64 address, u64 *data);
+	int (*cmos_range)(u16 func, unsigned int offset, u8 *buf,
+			  size_t length);
+	int (*pci)(u16 func, u32 device, u64 address, u64 *data);
+	int (*ec)(u16 func, u64 address, u64 *data);
+	int (*ec_range)(u16 func, unsigned int offset, u8 *buf, size_t length);
+	int (*msr)(u16 func, u32 cpu, u64 address, u64 *data);
+	int (*acpi_lookup)(const char *path, void **handle);
+	int (*acpi_integer)(void *handle, const char *path, const char *method,
+			    u64 *arg, u64 *result);
+	int (*br_levels)(void *handle, u32 *levels, u32 *num_of_levels);
+};
+
+int fwdt_core_run_op(const struct fwdt_backend *b, struct fwdt_batch_op *op,
+		     struct fwdt_batch_result *res);
+
+/* returns -ENOIOCTLCMD for commands that need the kernel side */
+long fwdt_core_ioctl(const struct fwdt_backend *b, unsigned int cmd,
+		     unsigned long arg);
+
+#endif
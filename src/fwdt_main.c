@@ -0,0 +1,5482 @@
+/*
+ * FWDT driver
+ *
+ * Copyright(C) 2012 Canonical Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define pr_fmt(fmt) "fwdt: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/platform_device.h>
+#include <linux/acpi.h>
+#include <acpi/acpi_drivers.h>
+#include <linux/pci.h>
+#include <acpi/acpi_bus.h>
+#include <acpi/video.h>
+#include <linux/proc_fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mc146818rtc.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/cpumask.h>
+#include <linux/smp.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/timex.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <asm/time.h>
+#include <asm/msr.h>
+
+#include "fwdt.h"
+#include "fwdt_core.h"
+
+#define CREATE_TRACE_POINTS
+#include "fwdt_trace.h"
+
+MODULE_AUTHOR("Alex Hung");
+MODULE_DESCRIPTION("FWDT Driver");
+MODULE_LICENSE("GPL");
+
+static int fwdt_setup(struct platform_device *device);
+static int __exit fwdt_remove(struct platform_device *device);
+
+static struct platform_driver fwdt_driver = {
+	.driver = {
+		.name = "fwdt",
+		.owner = THIS_MODULE,
+	},
+	.probe = fwdt_setup,
+	.remove = fwdt_remove,
+};
+
+static struct platform_device *fwdt_platform_dev;
+static struct dentry *fwdt_debugfs_dir;
+
+struct fwdt_sampler;
+static int fwdt_sampler_mmap(struct fwdt_sampler *s,
+			     struct vm_area_struct *vma);
+struct fwdt_ring_ctx;
+static int fwdt_ring_mmap(struct fwdt_ring_ctx *r, struct vm_area_struct *vma);
+
+/* state kept per open file of /dev/fwdt */
+struct fwdt_file {
+	struct mutex		lock;
+	struct pci_dev		*pdev;
+	u32			pci_device;
+	struct fwdt_sampler	*sampler;
+	struct fwdt_ring_ctx	*ring;
+	struct fwdt_watch_ctx	*watch;
+	bool			acpi_events;
+	struct fwdt_session_ctx	*session;
+	struct fwdt_scan_ctx	*scan;
+};
+
+#define FWDT_STAT_IOCTLS	32
+#define FWDT_STAT_FUNCS		16
+#define FWDT_STAT_ATTRS		32
+#define FWDT_STAT_BUCKETS	32
+
+/*
+ * Per-CPU call statistics. Bucket i of the histogram counts calls that
+ * took [2^i, 2^(i+1)) ns; the last bucket also takes anything slower.
+ */
+struct fwdt_stat {
+	u64	calls;
+	u64	errors;
+	u64	total_ns;
+	u64	min_ns;
+	u64	max_ns;
+	u32	hist[FWDT_STAT_BUCKETS];
+};
+
+/* indexed by _IOC_NR, each an array of FWDT_STAT_FUNCS sub-commands */
+static struct fwdt_stat __percpu *ioctl_stats[FWDT_STAT_IOCTLS];
+static const char * const ioctl_stat_names[FWDT_STAT_IOCTLS] = {
+	[0x00] = "unknown",
+	[0x01] = "acpi_vga",
+	[0x02] = "io",
+	[0x03] = "memory",
+	[0x04] = "cmos",
+	[0x05] = "batch",
+	[0x06] = "mmap_window",
+	[0x07] = "iomap_cache",
+	[0x08] = "pci_config",
+	[0x09] = "ec_range",
+	[0x0A] = "cmos_range",
+	[0x0B] = "msr_matrix",
+	[0x0C] = "msr_sampler",
+	[0x0D] = "io_range",
+	[0x0E] = "ring",
+	[0x0F] = "watch",
+	[0x10] = "acpi_event",
+	[0x11] = "acpi_eval",
+	[0x12] = "session",
+	[0x13] = "mem_scan",
+};
+
+/*
+ * sysfs attributes are registered through a copy that records the call
+ * and hands it on to the original, two stats each: show/read and
+ * store/write. Exactly one of attr and bin_attr is set.
+ */
+struct fwdt_stat_attr {
+	struct device_attribute	wrap;
+	struct bin_attribute	bin_wrap;
+	struct device_attribute	*attr;
+	struct bin_attribute	*bin_attr;
+};
+
+static struct fwdt_stat __percpu *attr_stats;
+static struct fwdt_stat __percpu *mem_dev_stats;	/* read() of fwdt_mem */
+static struct fwdt_stat_attr stat_attrs[FWDT_STAT_ATTRS];
+static int stat_attrs_count;
+
+static void fwdt_stat_record(struct fwdt_stat __percpu *stats, int slot,
+			     u64 start, bool error)
+{
+	struct fwdt_stat *st;
+	u64 ns = ktime_to_ns(ktime_get()) - start;
+	int bucket = ns ? min_t(int, ilog2(ns), FWDT_STAT_BUCKETS - 1) : 0;
+
+	if (!stats)
+		return;
+
+	st = get_cpu_ptr(stats) + slot;
+	if (!st->calls || ns < st->min_ns)
+		st->min_ns = ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	st->calls++;
+	st->total_ns += ns;
+	st->hist[bucket]++;
+	if (error)
+		st->errors++;
+	put_cpu_ptr(stats);
+}
+
+static void fwdt_stat_sum(struct fwdt_stat __percpu *stats, int slot,
+			  struct fwdt_stat *sum)
+{
+	struct fwdt_stat *st;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->min_ns = ULLONG_MAX;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(stats, cpu) + slot;
+		if (!st->calls)
+			continue;
+		sum->calls += st->calls;
+		sum->errors += st->errors;
+		sum->total_ns += st->total_ns;
+		sum->min_ns = min(sum->min_ns, st->min_ns);
+		sum->max_ns = max(sum->max_ns, st->max_ns);
+		for (i = 0; i < FWDT_STAT_BUCKETS; i++)
+			sum->hist[i] += st->hist[i];
+	}
+}
+
+/* upper bound in ns of the bucket holding the pct-th percentile */
+static u64 fwdt_stat_percentile(struct fwdt_stat *st, int pct)
+{
+	u64 want = div64_u64(st->calls * pct + 99, 100);
+	u64 seen = 0;
+	int i;
+
+	for (i = 0; i < FWDT_STAT_BUCKETS - 1; i++) {
+		seen += st->hist[i];
+		if (seen >= want)
+			break;
+	}
+
+	return 1ULL << (i + 1);
+}
+
+static int fwdt_stat_attr_index(struct device_attribute *attr,
+				struct bin_attribute *bin_attr)
+{
+	int i;
+
+	for (i = 0; i < stat_attrs_count; i++)
+		if (stat_attrs[i].attr == attr &&
+		    stat_attrs[i].bin_attr == bin_attr)
+			return i;
+
+	return -1;
+}
+
+static ssize_t fwdt_stat_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct fwdt_stat_attr *sa = container_of(attr, struct fwdt_stat_attr,
+						 wrap);
+	u64 start = ktime_to_ns(ktime_get());
+	ssize_t ret;
+
+	ret = sa->attr->show(dev, sa->attr, buf);
+	fwdt_stat_record(attr_stats, (sa - stat_attrs) * 2, start, ret < 0);
+
+	return ret;
+}
+
+static ssize_t fwdt_stat_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct fwdt_stat_attr *sa = container_of(attr, struct fwdt_stat_attr,
+						 wrap);
+	u64 start = ktime_to_ns(ktime_get());
+	ssize_t ret;
+
+	ret = sa->attr->store(dev, sa->attr, buf, count);
+	fwdt_stat_record(attr_stats, (sa - stat_attrs) * 2 + 1, start,
+			 ret < 0);
+
+	return ret;
+}
+
+static ssize_t fwdt_stat_bin_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct fwdt_stat_attr *sa = container_of(attr, struct fwdt_stat_attr,
+						 bin_wrap);
+	u64 start = ktime_to_ns(ktime_get());
+	ssize_t ret;
+
+	ret = sa->bin_attr->read(filp, kobj, sa->bin_attr, buf, off, count);
+	fwdt_stat_record(attr_stats, (sa - stat_attrs) * 2, start, ret < 0);
+
+	return ret;
+}
+
+static ssize_t fwdt_stat_bin_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct fwdt_stat_attr *sa = container_of(attr, struct fwdt_stat_attr,
+						 bin_wrap);
+	u64 start = ktime_to_ns(ktime_get());
+	ssize_t ret;
+
+	ret = sa->bin_attr->write(filp, kobj, sa->bin_attr, buf, off, count);
+	fwdt_stat_record(attr_stats, (sa - stat_attrs) * 2 + 1, start,
+			 ret < 0);
+
+	return ret;
+}
+
+/* the slot wrapping attr or bin_attr, allocated on first use */
+static struct fwdt_stat_attr *fwdt_stat_attr_get(struct device_attribute *attr,
+						 struct bin_attribute *bin_attr)
+{
+	struct fwdt_stat_attr *sa;
+	int i = fwdt_stat_attr_index(attr, bin_attr);
+
+	if (i >= 0)
+		return &stat_attrs[i];
+	if (stat_attrs_count >= FWDT_STAT_ATTRS)
+		return NULL;
+
+	sa = &stat_attrs[stat_attrs_count++];
+	sa->attr = attr;
+	sa->bin_attr = bin_attr;
+	if (attr) {
+		sa->wrap = *attr;
+		sysfs_attr_init(&sa->wrap.attr);
+		if (attr->show)
+			sa->wrap.show = fwdt_stat_show;
+		if (attr->store)
+			sa->wrap.store = fwdt_stat_store;
+	} else {
+		sa->bin_wrap = *bin_attr;
+		sysfs_attr_init(&sa->bin_wrap.attr);
+		if (bin_attr->read)
+			sa->bin_wrap.read = fwdt_stat_bin_read;
+		if (bin_attr->write)
+			sa->bin_wrap.write = fwdt_stat_bin_write;
+	}
+
+	return sa;
+}
+
+static const char *fwdt_stat_attr_name(struct fwdt_stat_attr *sa)
+{
+	return sa->attr ? sa->attr->attr.name : sa->bin_attr->attr.name;
+}
+
+/*
+ * device_create_file() and friends that route the attribute through the
+ * stats; attributes past FWDT_STAT_ATTRS are registered as they are.
+ */
+static int fwdt_device_create_file(struct device *dev,
+				   struct device_attribute *attr)
+{
+	struct fwdt_stat_attr *sa = fwdt_stat_attr_get(attr, NULL);
+
+	return device_create_file(dev, sa ? &sa->wrap : attr);
+}
+
+static void fwdt_device_remove_file(struct device *dev,
+				    struct device_attribute *attr)
+{
+	int i = fwdt_stat_attr_index(attr, NULL);
+
+	device_remove_file(dev, i >= 0 ? &stat_attrs[i].wrap : attr);
+}
+
+static int fwdt_device_create_bin_file(struct device *dev,
+				       struct bin_attribute *attr)
+{
+	struct fwdt_stat_attr *sa = fwdt_stat_attr_get(NULL, attr);
+
+	return device_create_bin_file(dev, sa ? &sa->bin_wrap : attr);
+}
+
+static void fwdt_device_remove_bin_file(struct device *dev,
+					struct bin_attribute *attr)
+{
+	int i = fwdt_stat_attr_index(NULL, attr);
+
+	device_remove_bin_file(dev, i >= 0 ? &stat_attrs[i].bin_wrap : attr);
+}
+
+static void fwdt_stats_print(struct seq_file *m, const char *kind,
+			     const char *name, int func,
+			     struct fwdt_stat __percpu *stats, int slot)
+{
+	struct fwdt_stat st;
+	int i;
+
+	fwdt_stat_sum(stats, slot, &st);
+	if (!st.calls)
+		return;
+
+	seq_printf(m, "%-6s %-16s %4d %10llu %8llu %10llu %10llu %10llu "
+		   "%10llu %10llu\n", kind, name, func, st.calls, st.errors,
+		   st.min_ns, div64_u64(st.total_ns, st.calls), st.max_ns,
+		   fwdt_stat_percentile(&st, 50),
+		   fwdt_stat_percentile(&st, 99));
+
+	seq_puts(m, "       hist");
+	for (i = 0; i < FWDT_STAT_BUCKETS; i++)
+		if (st.hist[i])
+			seq_printf(m, " %llu:%u", 1ULL << i, st.hist[i]);
+	seq_puts(m, "\n");
+}
+
+static int fwdt_stats_show(struct seq_file *m, void *v)
+{
+	int nr, func, i;
+
+	seq_printf(m, "%-6s %-16s %4s %10s %8s %10s %10s %10s %10s %10s\n",
+		   "type", "name", "func", "calls", "errors", "min_ns",
+		   "mean_ns", "max_ns", "p50_ns<", "p99_ns<");
+
+	for (nr = 0; nr < FWDT_STAT_IOCTLS; nr++) {
+		if (!ioctl_stats[nr])
+			continue;
+		for (func = 0; func < FWDT_STAT_FUNCS; func++)
+			fwdt_stats_print(m, "ioctl", ioctl_stat_names[nr] ?
+					 ioctl_stat_names[nr] : "unknown",
+					 func, ioctl_stats[nr], func);
+	}
+
+	if (!attr_stats)
+		return 0;
+
+	for (i = 0; i < stat_attrs_count; i++) {
+		fwdt_stats_print(m, stat_attrs[i].attr ? "show" : "read",
+				 fwdt_stat_attr_name(&stat_attrs[i]), 0,
+				 attr_stats, i * 2);
+		fwdt_stats_print(m, stat_attrs[i].attr ? "store" : "write",
+				 fwdt_stat_attr_name(&stat_attrs[i]), 0,
+				 attr_stats, i * 2 + 1);
+	}
+	fwdt_stats_print(m, "read", "fwdt_mem", 0, mem_dev_stats, 0);
+
+	return 0;
+}
+
+static void fwdt_stats_reset_slots(struct fwdt_stat __percpu *stats,
+				   int slots)
+{
+	int cpu;
+
+	if (!stats)
+		return;
+
+	/* racing updaters may leave a stray count, that is acceptable */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(stats, cpu), 0, slots * sizeof(*stats));
+}
+
+static ssize_t fwdt_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	int nr;
+
+	for (nr = 0; nr < FWDT_STAT_IOCTLS; nr++)
+		fwdt_stats_reset_slots(ioctl_stats[nr], FWDT_STAT_FUNCS);
+	fwdt_stats_reset_slots(attr_stats, FWDT_STAT_ATTRS * 2);
+	fwdt_stats_reset_slots(mem_dev_stats, 1);
+
+	return count;
+}
+
+static int fwdt_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fwdt_stats_show, NULL);
+}
+
+static const struct file_operations fwdt_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fwdt_stats_open,
+	.read		= seq_read,
+	.write		= fwdt_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void fwdt_stats_cleanup(void)
+{
+	int nr;
+
+	for (nr = 0; nr < FWDT_STAT_IOCTLS; nr++) {
+		free_percpu(ioctl_stats[nr]);
+		ioctl_stats[nr] = NULL;
+	}
+	free_percpu(attr_stats);
+	attr_stats = NULL;
+	free_percpu(mem_dev_stats);
+	mem_dev_stats = NULL;
+}
+
+/* statistics are best effort, a failed allocation only disables them */
+static void fwdt_stats_init(void)
+{
+	int nr;
+
+	for (nr = 0; nr < FWDT_STAT_IOCTLS; nr++) {
+		ioctl_stats[nr] = __alloc_percpu(FWDT_STAT_FUNCS *
+						 sizeof(struct fwdt_stat),
+						 __alignof__(struct fwdt_stat));
+		if (!ioctl_stats[nr])
+			goto err;
+	}
+
+	attr_stats = __alloc_percpu(FWDT_STAT_ATTRS * 2 *
+				    sizeof(struct fwdt_stat),
+				    __alignof__(struct fwdt_stat));
+	if (!attr_stats)
+		goto err;
+
+	mem_dev_stats = alloc_percpu(struct fwdt_stat);
+	if (!mem_dev_stats)
+		goto err;
+
+	return;
+
+ err:
+	pr_info("no memory for statistics, disabled\n");
+	fwdt_stats_cleanup();
+}
+
+static acpi_status acpi_handle_locate_callback(acpi_handle handle,
+			u32 level, void *context, void **return_value)
+{
+	*(acpi_handle *)return_value = handle;
+
+	return AE_CTRL_TERMINATE;
+}
+
+static void acpi_device_path(const char *buf, char *path)
+{
+	path[0] = '\\';
+	strncpy(path + 1, buf, strlen(buf));	
+	path[strlen(buf)] = 0;
+}
+
+#define FWDT_ACPI_HANDLE_HASH_BITS	6
+#define FWDT_ACPI_HANDLE_CACHE_SIZE	64
+
+struct fwdt_acpi_handle_entry {
+	struct hlist_node	node;
+	acpi_handle		handle;
+	char			path[];
+};
+
+static DEFINE_HASHTABLE(acpi_handle_hash, FWDT_ACPI_HANDLE_HASH_BITS);
+static DEFINE_MUTEX(acpi_handle_lock);
+static unsigned int acpi_handle_entries;
+static bool acpi_table_handler_installed;
+static u64 acpi_handle_hits;
+static u64 acpi_handle_misses;
+static u64 acpi_handle_flushes;
+
+/* bumped on every ACPI table load/unload; cached handles die with it */
+static atomic_t acpi_table_generation = ATOMIC_INIT(0);
+static int acpi_handle_generation;
+static u32 acpi_table_count;
+
+static acpi_status fwdt_acpi_table_handler(u32 event, void *table,
+					   void *context)
+{
+	atomic_inc(&acpi_table_generation);
+
+	return AE_OK;
+}
+
+/*
+ * ACPICA takes a single table handler and the ACPI sysfs code usually
+ * owns it, so without one notice loads by probing past the last table
+ * seen. As with ec_device and video_device, this assumes tables loaded
+ * before the driver are not unloaded. Called with acpi_handle_lock held.
+ */
+static bool fwdt_acpi_tables_changed(void)
+{
+	struct acpi_table_header *table;
+	bool changed = false;
+
+	while (ACPI_SUCCESS(acpi_get_table_by_index(acpi_table_count,
+						    &table))) {
+		acpi_table_count++;
+		changed = true;
+	}
+
+	return changed;
+}
+
+/* must be called with acpi_handle_lock held */
+static void fwdt_acpi_handle_flush(void)
+{
+	struct fwdt_acpi_handle_entry *entry;
+	struct hlist_node *tmp;
+	int bkt;
+
+	hash_for_each_safe(acpi_handle_hash, bkt, tmp, entry, node) {
+		hash_del(&entry->node);
+		kfree(entry);
+	}
+	acpi_handle_entries = 0;
+	acpi_handle_flushes++;
+}
+
+static acpi_status fwdt_get_acpi_handle(const char *path, acpi_handle *handle)
+{
+	struct fwdt_acpi_handle_entry *entry;
+	acpi_status status;
+	u32 key = jhash(path, strlen(path), 0);
+	int generation;
+
+	mutex_lock(&acpi_handle_lock);
+
+	generation = atomic_read(&acpi_table_generation);
+	if (generation != acpi_handle_generation ||
+	    (!acpi_table_handler_installed && fwdt_acpi_tables_changed())) {
+		fwdt_acpi_handle_flush();
+		acpi_handle_generation = generation;
+	}
+
+	hash_for_each_possible(acpi_handle_hash, entry, node, key) {
+		if (strcmp(entry->path, path))
+			continue;
+		*handle = entry->handle;
+		acpi_handle_hits++;
+		mutex_unlock(&acpi_handle_lock);
+		return AE_OK;
+	}
+
+	acpi_handle_misses++;
+	status = acpi_get_handle(NULL, (acpi_string) path, handle);
+	if (!ACPI_SUCCESS(status))
+		goto out;
+
+	if (acpi_handle_entries >= FWDT_ACPI_HANDLE_CACHE_SIZE)
+		fwdt_acpi_handle_flush();
+
+	entry = kmalloc(sizeof(*entry) + strlen(path) + 1, GFP_KERNEL);
+	if (entry) {
+		entry->handle = *handle;
+		strcpy(entry->path, path);
+		hash_add(acpi_handle_hash, &entry->node, key);
+		acpi_handle_entries++;
+	}
+
+ out:
+	mutex_unlock(&acpi_handle_lock);
+	return status;
+}
+
+static int acpi_handle_cache_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&acpi_handle_lock);
+	seq_printf(m, "table_handler: %d\n", acpi_table_handler_installed);
+	seq_printf(m, "entries: %u\n", acpi_handle_entries);
+	seq_printf(m, "hits: %llu\n", acpi_handle_hits);
+	seq_printf(m, "misses: %llu\n", acpi_handle_misses);
+	seq_printf(m, "flushes: %llu\n", acpi_handle_flushes);
+	mutex_unlock(&acpi_handle_lock);
+
+	return 0;
+}
+
+static int acpi_handle_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, acpi_handle_cache_show, NULL);
+}
+
+static const struct file_operations acpi_handle_cache_fops = {
+	.owner		= THIS_MODULE,
+	.open		= acpi_handle_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#define FWDT_AML_PROFILE_HASH_BITS	6
+#define FWDT_AML_PROFILE_SIZE		256
+
+/* time spent in every object the driver evaluated, by handle and method */
+struct fwdt_aml_profile {
+	struct hlist_node	node;
+	acpi_handle		handle;
+	char			method[32];
+	char			path[64];	/* full path, for display */
+	u64			count;
+	u64			total_ns;
+	u64			min_ns;
+	u64			max_ns;
+	acpi_status		last_status;
+};
+
+static DEFINE_HASHTABLE(aml_profile_hash, FWDT_AML_PROFILE_HASH_BITS);
+static DEFINE_MUTEX(aml_profile_lock);
+static unsigned int aml_profile_entries;
+static u64 aml_profile_dropped;
+
+static void fwdt_aml_profile_name(struct fwdt_aml_profile *p)
+{
+	struct acpi_buffer name = { sizeof(p->path), p->path };
+
+	if (!ACPI_SUCCESS(acpi_get_name(p->handle, ACPI_FULL_PATHNAME,
+					&name)))
+		strcpy(p->path, "?");
+	if (p->method[0]) {
+		strlcat(p->path, ".", sizeof(p->path));
+		strlcat(p->path, p->method, sizeof(p->path));
+	}
+}
+
+static void fwdt_aml_profile(acpi_handle handle, const char *method,
+			     acpi_status status, u64 ns)
+{
+	struct fwdt_aml_profile *p;
+	u32 key;
+
+	if (!method)
+		method = "";
+	key = jhash(method, strlen(method), (u32) (unsigned long) handle);
+
+	mutex_lock(&aml_profile_lock);
+	hash_for_each_possible(aml_profile_hash, p, node, key)
+		if (p->handle == handle && !strcmp(p->method, method))
+			goto found;
+
+	if (aml_profile_entries >= FWDT_AML_PROFILE_SIZE) {
+		aml_profile_dropped++;
+		goto out;
+	}
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p) {
+		aml_profile_dropped++;
+		goto out;
+	}
+	p->handle = handle;
+	strlcpy(p->method, method, sizeof(p->method));
+	fwdt_aml_profile_name(p);
+	hash_add(aml_profile_hash, &p->node, key);
+	aml_profile_entries++;
+
+ found:
+	if (!p->count || ns < p->min_ns)
+		p->min_ns = ns;
+	if (ns > p->max_ns)
+		p->max_ns = ns;
+	p->count++;
+	p->total_ns += ns;
+	p->last_status = status;
+ out:
+	mutex_unlock(&aml_profile_lock);
+}
+
+/* must be called with aml_profile_lock held */
+static void fwdt_aml_profile_flush(void)
+{
+	struct fwdt_aml_profile *p;
+	struct hlist_node *tmp;
+	int bkt;
+
+	hash_for_each_safe(aml_profile_hash, bkt, tmp, p, node) {
+		hash_del(&p->node);
+		kfree(p);
+	}
+	aml_profile_entries = 0;
+	aml_profile_dropped = 0;
+}
+
+static int fwdt_aml_profile_cmp(const void *a, const void *b)
+{
+	const struct fwdt_aml_profile *pa = *(struct fwdt_aml_profile **) a;
+	const struct fwdt_aml_profile *pb = *(struct fwdt_aml_profile **) b;
+
+	if (pa->total_ns == pb->total_ns)
+		return 0;
+	return pa->total_ns < pb->total_ns ? 1 : -1;
+}
+
+/* hottest first, by total time */
+static int aml_profile_show(struct seq_file *m, void *v)
+{
+	struct fwdt_aml_profile **sorted, *p;
+	unsigned int n = 0, i;
+	int bkt;
+
+	mutex_lock(&aml_profile_lock);
+	sorted = kcalloc(aml_profile_entries + 1, sizeof(*sorted), GFP_KERNEL);
+	if (!sorted) {
+		mutex_unlock(&aml_profile_lock);
+		return -ENOMEM;
+	}
+	hash_for_each(aml_profile_hash, bkt, p, node)
+		sorted[n++] = p;
+	sort(sorted, n, sizeof(*sorted), fwdt_aml_profile_cmp, NULL);
+
+	seq_printf(m, "%-48s %10s %14s %10s %10s %10s %8s\n", "path", "count",
+		   "total_ns", "min_ns", "mean_ns", "max_ns", "status");
+	for (i = 0; i < n; i++) {
+		p = sorted[i];
+		seq_printf(m, "%-48s %10llu %14llu %10llu %10llu %10llu "
+			   "%8x\n", p->path, p->count, p->total_ns, p->min_ns,
+			   div64_u64(p->total_ns, p->count), p->max_ns,
+			   p->last_status);
+	}
+	if (aml_profile_dropped)
+		seq_printf(m, "dropped: %llu\n", aml_profile_dropped);
+	mutex_unlock(&aml_profile_lock);
+
+	kfree(sorted);
+	return 0;
+}
+
+static ssize_t aml_profile_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	mutex_lock(&aml_profile_lock);
+	fwdt_aml_profile_flush();
+	mutex_unlock(&aml_profile_lock);
+
+	return count;
+}
+
+static int aml_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, aml_profile_show, NULL);
+}
+
+static const struct file_operations aml_profile_fops = {
+	.owner		= THIS_MODULE,
+	.open		= aml_profile_open,
+	.read		= seq_read,
+	.write		= aml_profile_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * acpi_evaluate_object/integer with a tracepoint and the AML profile
+ * around them; path only labels the event and may be NULL when just the
+ * handle is known.
+ */
+static acpi_status fwdt_acpi_evaluate(acpi_handle handle, const char *path,
+				      char *method,
+				      struct acpi_object_list *args,
+				      struct acpi_buffer *buf)
+{
+	acpi_status status;
+	cycles_t start;
+	ktime_t t0;
+
+	t0 = ktime_get();
+	start = get_cycles();
+	status = acpi_evaluate_object(handle, method, args, buf);
+	trace_fwdt_acpi_eval(handle, path, method, status,
+			     get_cycles() - start);
+	fwdt_aml_profile(handle, method, status,
+			 ktime_to_ns(ktime_sub(ktime_get(), t0)));
+
+	return status;
+}
+
+static acpi_status fwdt_acpi_evaluate_integer(acpi_handle handle,
+					      const char *path, char *method,
+					      struct acpi_object_list *args,
+					      unsigned long long *data)
+{
+	acpi_status status;
+	cycles_t start;
+	ktime_t t0;
+
+	t0 = ktime_get();
+	start = get_cycles();
+	status = acpi_evaluate_integer(handle, method, args, data);
+	trace_fwdt_acpi_eval(handle, path, method, status,
+			     get_cycles() - start);
+	fwdt_aml_profile(handle, method, status,
+			 ktime_to_ns(ktime_sub(ktime_get(), t0)));
+
+	return status;
+}
+
+static ssize_t acpi_method_0_0_write(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_handle device;
+	acpi_status status;
+	char path[255];
+
+	acpi_device_path(buf, path);
+
+	status = fwdt_get_acpi_handle(path, &device);
+	if (!ACPI_SUCCESS(status)) {
+		printk("Failed to find acpi method: %s\n", path);
+		goto err;
+	}
+
+	status = fwdt_acpi_evaluate(device, path, NULL, NULL, NULL);
+	if (ACPI_SUCCESS(status))
+		printk("Executed %s\n", path);
+	else
+		printk("Failed to execute %s\n", path);
+
+      err:
+	return count;
+}
+static DEVICE_ATTR(acpi_method_0_0, S_IWUSR, NULL, acpi_method_0_0_write);
+
+/*
+ * The method paths and argument selected through sysfs. Readers take a
+ * copy under acpi_sel_lock and evaluate without it, so a slow method
+ * doesn't hold up other selections.
+ */
+static DEFINE_MUTEX(acpi_sel_lock);
+static char device_path_0_1[256];
+static ssize_t acpi_method_0_1_read(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	acpi_handle device;
+	acpi_status status;
+	unsigned long long output = 0;
+	char path[256];
+
+	mutex_lock(&acpi_sel_lock);
+	strcpy(path, device_path_0_1);
+	mutex_unlock(&acpi_sel_lock);
+
+	status = fwdt_get_acpi_handle(path, &device);
+	if (ACPI_SUCCESS(status))
+		status = fwdt_acpi_evaluate_integer(device, path,
+						    NULL, NULL, &output);
+	if (ACPI_SUCCESS(status))
+		printk("Executed %s\n", path);
+	else
+		printk("Failed to execute %s\n", path);
+
+	return sprintf(buf, "0x%08llx\n", output);
+}
+
+static ssize_t acpi_method_0_1_write(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_handle device;
+	acpi_status status;
+
+	char path[256];
+
+	acpi_device_path(buf, path);
+	mutex_lock(&acpi_sel_lock);
+	strcpy(device_path_0_1, path);
+	mutex_unlock(&acpi_sel_lock);
+
+	status = fwdt_get_acpi_handle(path, &device);
+	if (!ACPI_SUCCESS(status)) {
+		printk("Failed to find acpi method: %s\n", path);
+	}
+
+	return count;
+}
+static DEVICE_ATTR(acpi_method_0_1, S_IRUGO | S_IWUSR,
+		acpi_method_0_1_read, acpi_method_0_1_write);
+
+static char acpi_method[256];
+static ssize_t acpi_method_read(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&acpi_sel_lock);
+	ret = sprintf(buf, "%s\n", acpi_method);
+	mutex_unlock(&acpi_sel_lock);
+
+	return ret;
+}
+
+static ssize_t acpi_method_write(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_handle device;
+	acpi_status status;
+
+	char path[256];
+
+	acpi_device_path(buf, path);
+	mutex_lock(&acpi_sel_lock);
+	strcpy(acpi_method, path);
+	mutex_unlock(&acpi_sel_lock);
+
+	status = fwdt_get_acpi_handle(path, &device);
+	if (!ACPI_SUCCESS(status)) {
+		printk("Failed to find acpi method: %s\n", path);
+	}
+
+	return count;
+}
+
+static DEVICE_ATTR(acpi_method, S_IRUGO | S_IWUSR,
+		acpi_method_read, acpi_method_write);
+
+/* a single aligned u32, so it needs no lock of its own */
+static u32 acpi_arg0;
+static ssize_t acpi_arg1_read(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%08x\n", acpi_arg0);
+}
+
+static ssize_t acpi_arg1_write(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_arg0 = simple_strtoul(buf, NULL, 16);
+
+	return count;
+}
+
+static DEVICE_ATTR(acpi_arg0, S_IRUGO | S_IWUSR,
+		acpi_arg1_read, acpi_arg1_write);
+
+static ssize_t acpi_method_1_1_read(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	acpi_handle device;
+	acpi_status status;
+	unsigned long long output = 0;
+	union acpi_object arg0 = { ACPI_TYPE_INTEGER };
+	struct acpi_object_list args = { 1, &arg0 };
+	char path[256];
+
+	mutex_lock(&acpi_sel_lock);
+	strcpy(path, acpi_method);
+	arg0.integer.value = acpi_arg0;
+	mutex_unlock(&acpi_sel_lock);
+
+	status = fwdt_get_acpi_handle(path, &device);
+	if (ACPI_SUCCESS(status))
+		status = fwdt_acpi_evaluate_integer(device, path,
+						    NULL, &args, &output);
+	if (ACPI_SUCCESS(status))
+		printk("Executed %s\n", path);
+	else
+		printk("Failed to execute %s\n", path);
+
+	return sprintf(buf, "0x%08llx\n", output);
+}
+
+static DEVICE_ATTR(acpi_method_1_1, S_IRUGO, acpi_method_1_1_read, NULL);
+
+static int acpi_lcd_query_levels(acpi_handle *device,
+				   union acpi_object **levels)
+{
+	int status;
+	struct acpi_buffer buffer = { ACPI_ALLOCATE_BUFFER, NULL };
+	union acpi_object *obj;
+
+	*levels = NULL;
+
+	status = fwdt_acpi_evaluate(device, NULL, "_BCL", NULL, &buffer);
+	if (!ACPI_SUCCESS(status))
+		return status;
+	obj = (union acpi_object *)buffer.pointer;
+	if (!obj || (obj->type != ACPI_TYPE_PACKAGE)) {
+		printk("Invalid _BCL data\n");
+		status = -EFAULT;
+		goto err;
+	}
+
+	*levels = obj;
+
+	return 0;
+
+      err:
+	kfree(buffer.pointer);
+
+	return status;
+}
+
+/* matches the size of fwdt_brightness.levels */
+#define FWDT_BR_LEVELS		256
+#define FWDT_BCL_CACHE_SIZE	8
+
+/*
+ * Parsed _BCL tables, one per LCD device. Entries are never reused for
+ * another device since their address is the notify handler context.
+ */
+struct fwdt_bcl_cache {
+	acpi_handle	device;
+	bool		valid;
+	u32		num_of_levels;
+	u32		levels[FWDT_BR_LEVELS];
+};
+
+static struct fwdt_bcl_cache bcl_cache[FWDT_BCL_CACHE_SIZE];
+static unsigned int bcl_cache_entries;
+static DEFINE_MUTEX(bcl_cache_lock);
+
+static void fwdt_bcl_notify(acpi_handle handle, u32 event, void *context)
+{
+	struct fwdt_bcl_cache *bcl = context;
+
+	bcl->valid = false;
+}
+
+static struct fwdt_bcl_cache *fwdt_bcl_lookup(acpi_handle device)
+{
+	struct fwdt_bcl_cache *bcl;
+	acpi_status status;
+	int i;
+
+	for (i = 0; i < bcl_cache_entries; i++)
+		if (bcl_cache[i].device == device)
+			return &bcl_cache[i];
+
+	if (bcl_cache_entries >= FWDT_BCL_CACHE_SIZE)
+		return NULL;
+
+	bcl = &bcl_cache[bcl_cache_entries];
+	bcl->valid = false;
+	status = acpi_install_notify_handler(device, ACPI_DEVICE_NOTIFY,
+					     fwdt_bcl_notify, bcl);
+	if (!ACPI_SUCCESS(status))
+		return NULL;
+
+	bcl->device = device;
+	bcl_cache_entries++;
+
+	return bcl;
+}
+
+/*
+ * Copy the brightness levels of an LCD device into levels[FWDT_BR_LEVELS].
+ * _BCL is evaluated only when the cached table was invalidated by a notify
+ * on the device, or when no notify handler could be installed.
+ */
+static int fwdt_get_br_levels(acpi_handle device, u32 *levels,
+			      u32 *num_of_levels)
+{
+	struct fwdt_bcl_cache *bcl;
+	union acpi_object *obj, *o;
+	u32 *dst;
+	u32 count;
+	int status = 0;
+	int i;
+
+	mutex_lock(&bcl_cache_lock);
+
+	bcl = fwdt_bcl_lookup(device);
+	if (bcl && bcl->valid)
+		goto copy;
+
+	/* a notify arriving while _BCL runs clears this again */
+	if (bcl)
+		bcl->valid = true;
+
+	status = acpi_lcd_query_levels(device, &obj);
+	if (!ACPI_SUCCESS(status)) {
+		if (bcl)
+			bcl->valid = false;
+		goto out;
+	}
+
+	dst = bcl ? bcl->levels : levels;
+	count = min_t(u32, obj->package.count, FWDT_BR_LEVELS);
+	for (i = 0; i < count; i++) {
+		o = (union acpi_object *) &obj->package.elements[i];
+		dst[i] = o->type == ACPI_TYPE_INTEGER ? (u32) o->integer.value : 0;
+	}
+	kfree(obj);
+
+	if (!bcl) {
+		*num_of_levels = count;
+		goto out;
+	}
+	bcl->num_of_levels = count;
+
+ copy:
+	*num_of_levels = bcl->num_of_levels;
+	memcpy(levels, bcl->levels, bcl->num_of_levels * sizeof(u32));
+ out:
+	mutex_unlock(&bcl_cache_lock);
+	return status;
+}
+
+static void fwdt_bcl_cache_cleanup(void)
+{
+	int i;
+
+	mutex_lock(&bcl_cache_lock);
+	for (i = 0; i < bcl_cache_entries; i++)
+		acpi_remove_notify_handler(bcl_cache[i].device,
+					   ACPI_DEVICE_NOTIFY, fwdt_bcl_notify);
+	bcl_cache_entries = 0;
+	mutex_unlock(&bcl_cache_lock);
+}
+
+/* the LCD selected through sysfs; the handle and path change together */
+static DEFINE_MUTEX(video_lock);
+static acpi_handle video_device;
+static char video_device_path[255];
+
+static acpi_handle acpi_video_get_device(char *path)
+{
+	acpi_handle device;
+
+	mutex_lock(&video_lock);
+	device = video_device;
+	strcpy(path, video_device_path);
+	mutex_unlock(&video_lock);
+
+	return device;
+}
+
+static ssize_t acpi_video_write_device(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_status status;
+	acpi_handle device = NULL;
+	char device_path[255];
+	
+	device_path[0] = '\\';
+	strncpy(device_path + 1, buf, strlen(buf));	
+	device_path[strlen(buf)] = 0;
+
+	status = fwdt_get_acpi_handle(device_path, &device);
+	if (!ACPI_SUCCESS(status))
+		printk("Failed to find video device: %s!\n", buf);
+
+	mutex_lock(&video_lock);
+	video_device = device;
+	strcpy(video_device_path, device_path);
+	mutex_unlock(&video_lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(video_device, S_IWUSR, NULL, acpi_video_write_device);
+
+static ssize_t acpi_video_read_brightness(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	acpi_status status;
+	unsigned long long bqc_level = 0;
+	acpi_handle video_device;
+	char video_device_path[255];
+	u32 *levels;
+	u32 num_of_levels;
+	cycles_t start;
+	int i;
+
+	video_device = acpi_video_get_device(video_device_path);
+	if (!video_device) {
+		printk("acpi_video device is not specified!\n");
+		return -ENODEV;
+	}
+
+	start = get_cycles();
+	status = fwdt_acpi_evaluate_integer(video_device, video_device_path,
+					    "_BQC", NULL, &bqc_level);
+	trace_fwdt_brightness(video_device_path, GET_BRIGHTNESS, bqc_level,
+			      ACPI_SUCCESS(status) ? FWDT_SUCCESS : FWDT_FAIL,
+			      get_cycles() - start);
+	if (!ACPI_SUCCESS(status)) {
+		printk("Failed to read brightness level!\n");
+		return -ENODEV;
+	}
+
+	levels = kmalloc(FWDT_BR_LEVELS * sizeof(u32), GFP_KERNEL);
+	if (!levels)
+		goto no_bcl;
+
+	if (!ACPI_SUCCESS(fwdt_get_br_levels(video_device, levels,
+					     &num_of_levels))) {
+		printk("Failed to query brightness levels\n");
+		goto no_bcl;
+	}
+
+	for (i = 0; i < num_of_levels; i++)
+		printk("Brightness[%d] = %d\n", i, levels[i]);
+
+      no_bcl:
+	kfree(levels);
+
+	return sprintf(buf, "%lld\n", bqc_level);
+}
+
+static ssize_t acpi_video_write_brightness(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_status status;
+	union acpi_object arg0 = { ACPI_TYPE_INTEGER };
+	struct acpi_object_list args = { 1, &arg0 };
+	acpi_handle video_device;
+	char video_device_path[255];
+	cycles_t start;
+
+	video_device = acpi_video_get_device(video_device_path);
+	if (!video_device) {
+		printk("acpi_video device is not specified!\n");
+		return count;
+	}
+
+	arg0.integer.value = simple_strtoul(buf, NULL, 10);
+
+	start = get_cycles();
+	status = fwdt_acpi_evaluate(video_device, video_device_path, "_BCM",
+				    &args, NULL);
+	trace_fwdt_brightness(video_device_path, SET_BRIGHTNESS,
+			      arg0.integer.value,
+			      ACPI_SUCCESS(status) ? FWDT_SUCCESS : FWDT_FAIL,
+			      get_cycles() - start);
+	if (!ACPI_SUCCESS(status))
+		printk("Failed to set brightness level!\n");
+
+	return count;
+}
+
+static DEVICE_ATTR(video_brightness, S_IRUGO | S_IWUSR,
+	acpi_video_read_brightness, acpi_video_write_brightness);
+
+#define FWDT_IOMAP_CACHE_SIZE	32
+
+/* page-granular ioremap() mappings, most recently used first */
+struct fwdt_iomap {
+	struct list_head	list;
+	u64			page;
+	void __iomem		*virt;
+};
+
+static LIST_HEAD(iomap_lru);
+static DEFINE_MUTEX(iomap_lock);
+static unsigned int iomap_entries;
+static u64 iomap_hits;
+static u64 iomap_misses;
+
+/* must be called with iomap_lock held */
+static void __iomem *fwdt_iomap(u64 address)
+{
+	struct fwdt_iomap *map;
+	void __iomem *virt;
+	u64 page = address & PAGE_MASK;
+
+	list_for_each_entry(map, &iomap_lru, list) {
+		if (map->page != page)
+			continue;
+		list_move(&map->list, &iomap_lru);
+		iomap_hits++;
+		return map->virt + (address - page);
+	}
+
+	iomap_misses++;
+	virt = ioremap(page, PAGE_SIZE);
+	if (!virt)
+		return NULL;
+
+	if (iomap_entries < FWDT_IOMAP_CACHE_SIZE) {
+		map = kmalloc(sizeof(*map), GFP_KERNEL);
+		if (!map) {
+			iounmap(virt);
+			return NULL;
+		}
+		iomap_entries++;
+	} else {
+		map = list_entry(iomap_lru.prev, struct fwdt_iomap, list);
+		list_del(&map->list);
+		iounmap(map->virt);
+	}
+
+	map->page = page;
+	map->virt = virt;
+	list_add(&map->list, &iomap_lru);
+
+	return virt + (address - page);
+}
+
+static void fwdt_iomap_flush(void)
+{
+	struct fwdt_iomap *map, *tmp;
+
+	mutex_lock(&iomap_lock);
+	list_for_each_entry_safe(map, tmp, &iomap_lru, list) {
+		list_del(&map->list);
+		iounmap(map->virt);
+		kfree(map);
+	}
+	iomap_entries = 0;
+	mutex_unlock(&iomap_lock);
+}
+
+static int fwdt_mem_access(u16 func, u64 address, u64 *data)
+{
+	void __iomem *mem;
+	int ret = FWDT_SUCCESS;
+	cycles_t start = 0;
+	bool cached;
+
+	/* an access straddling a page boundary can't use the cache */
+	cached = (address & ~PAGE_MASK) <= PAGE_SIZE - sizeof(u32);
+	if (cached) {
+		mutex_lock(&iomap_lock);
+		mem = fwdt_iomap(address);
+	} else {
+		mem = ioremap(address, sizeof(u32));
+	}
+	if (!mem) {
+		ret = FWDT_FAIL;
+		goto out;
+	}
+
+	start = get_cycles();
+	switch (func) {
+	case GET_DATA_BYTE:
+		*data = readb(mem);
+		break;
+	case GET_DATA_WORD:
+		*data = readw(mem);
+		break;
+	case GET_DATA_DWORD:
+		*data = readl(mem);
+		break;
+	case SET_DATA_BYTE:
+		writeb(*data, mem);
+		break;
+	case SET_DATA_WORD:
+		writew(*data, mem);
+		break;
+	case SET_DATA_DWORD:
+		writel(*data, mem);
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		break;
+	}
+
+ out:
+	trace_fwdt_mem(func, 0, address, *data, ret,
+		       start ? get_cycles() - start : 0);
+	if (cached)
+		mutex_unlock(&iomap_lock);
+	else if (mem)
+		iounmap(mem);
+	return ret;
+}
+
+static int fwdt_io_access(u16 func, u16 port, u64 *data)
+{
+	cycles_t start = get_cycles();
+	int ret = FWDT_SUCCESS;
+
+	switch (func) {
+	case GET_DATA_BYTE:
+		*data = inb(port);
+		break;
+	case GET_DATA_WORD:
+		*data = inw(port);
+		break;
+	case GET_DATA_DWORD:
+		*data = inl(port);
+		break;
+	case SET_DATA_BYTE:
+		outb(*data, port);
+		break;
+	case SET_DATA_WORD:
+		outw(*data, port);
+		break;
+	case SET_DATA_DWORD:
+		outl(*data, port);
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		break;
+	}
+
+	trace_fwdt_io(func, 0, port, *data, ret, get_cycles() - start);
+	return ret;
+}
+
+/* the upper 128 bytes of NVRAM sit behind a second index/data pair */
+#define FWDT_CMOS_EXT_INDEX	0x72
+#define FWDT_CMOS_EXT_DATA	0x73
+#define FWDT_CMOS_SIZE		256
+
+/* Read or write a range of NVRAM, taking rtc_lock once for the range. */
+static int fwdt_cmos_range(u16 func, unsigned int offset, u8 *buf,
+			   size_t length)
+{
+	unsigned long flags;
+	unsigned int addr;
+	cycles_t start;
+	int i;
+
+	if (offset + length > FWDT_CMOS_SIZE)
+		return -EINVAL;
+
+	spin_lock_irqsave(&rtc_lock, flags);
+	start = get_cycles();
+	for (i = 0; i < length; i++) {
+		addr = offset + i;
+		if (addr < 0x80 && func == READ_CMOS_RANGE) {
+			buf[i] = CMOS_READ(addr);
+		} else if (addr < 0x80) {
+			CMOS_WRITE(buf[i], addr);
+		} else {
+			outb(addr, FWDT_CMOS_EXT_INDEX);
+			if (func == READ_CMOS_RANGE)
+				buf[i] = inb(FWDT_CMOS_EXT_DATA);
+			else
+				outb(buf[i], FWDT_CMOS_EXT_DATA);
+		}
+	}
+	start = get_cycles() - start;
+	spin_unlock_irqrestore(&rtc_lock, flags);
+
+	trace_fwdt_cmos_range(func, 0, offset, length, 0, start);
+	return 0;
+}
+
+static int fwdt_cmos_access(u16 func, u64 address, u64 *data)
+{
+	u8 b = *data;
+
+	if (address >= FWDT_CMOS_SIZE)
+		return FWDT_FAIL;
+
+	switch (func) {
+	case GET_DATA_BYTE:
+		fwdt_cmos_range(READ_CMOS_RANGE, address, &b, 1);
+		*data = b;
+		break;
+	case SET_DATA_BYTE:
+		fwdt_cmos_range(WRITE_CMOS_RANGE, address, &b, 1);
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+
+	return FWDT_SUCCESS;
+}
+
+static int fwdt_pci_dev_access(struct pci_dev *pdev, u16 func, u64 address,
+			       u64 *data)
+{
+	cycles_t start;
+	int ret;
+	u8 b;
+	u16 w;
+	u32 d;
+	int err;
+
+	if (address > 0xFFF)
+		return FWDT_FAIL;
+
+	start = get_cycles();
+	switch (func) {
+	case GET_DATA_BYTE:
+		err = pci_read_config_byte(pdev, address, &b);
+		*data = b;
+		break;
+	case GET_DATA_WORD:
+		err = pci_read_config_word(pdev, address, &w);
+		*data = w;
+		break;
+	case GET_DATA_DWORD:
+		err = pci_read_config_dword(pdev, address, &d);
+		*data = d;
+		break;
+	case SET_DATA_BYTE:
+		err = pci_write_config_byte(pdev, address, *data);
+		break;
+	case SET_DATA_WORD:
+		err = pci_write_config_word(pdev, address, *data);
+		break;
+	case SET_DATA_DWORD:
+		err = pci_write_config_dword(pdev, address, *data);
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+	start = get_cycles() - start;
+
+	ret = err ? FWDT_FAIL : FWDT_SUCCESS;
+	trace_fwdt_pci(func, FWDT_PCI_DEVICE(pci_domain_nr(pdev->bus),
+					     pdev->bus->number,
+					     PCI_SLOT(pdev->devfn),
+					     PCI_FUNC(pdev->devfn)),
+		       address, *data, ret, start);
+	return ret;
+}
+
+static int fwdt_pci_access(u16 func, u32 device, u64 address, u64 *data)
+{
+	struct pci_dev *pdev;
+	int ret;
+
+	if (address > 0xFFF)
+		return FWDT_FAIL;
+
+	pdev = pci_get_domain_bus_and_slot(device >> 16, (device >> 8) & 0xFF,
+					   device & 0xFF);
+	if (!pdev)
+		return FWDT_DEVICE_NOT_FOUND;
+
+	ret = fwdt_pci_dev_access(pdev, func, address, data);
+	pci_dev_put(pdev);
+	return ret;
+}
+
+static int fwdt_ec_access(u16 func, u64 address, u64 *data)
+{
+	int ret = FWDT_SUCCESS;
+	cycles_t start;
+	u8 b;
+
+	if (address > 0xFF)
+		return FWDT_FAIL;
+
+	start = get_cycles();
+	switch (func) {
+	case GET_DATA_BYTE:
+		if (ec_read(address, &b))
+			ret = FWDT_FAIL;
+		else
+			*data = b;
+		break;
+	case SET_DATA_BYTE:
+		if (ec_write(address, *data))
+			ret = FWDT_FAIL;
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+
+	trace_fwdt_ec(func, 0, address, *data, ret, get_cycles() - start);
+	return ret;
+}
+
+static int fwdt_msr_access(u16 func, u32 cpu, u64 address, u64 *data)
+{
+	int ret = FWDT_SUCCESS;
+	cycles_t start;
+	u32 h, l;
+
+	start = get_cycles();
+	switch (func) {
+	case GET_DATA_QWORD:
+		if (rdmsr_safe_on_cpu(cpu, address, &l, &h))
+			ret = FWDT_FAIL;
+		else
+			*data = ((u64) h << 32) | l;
+		break;
+	case SET_DATA_QWORD:
+		if (wrmsr_safe_on_cpu(cpu, address, (u32) *data,
+				      (u32) (*data >> 32)))
+			ret = FWDT_FAIL;
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+
+	trace_fwdt_msr(func, cpu, address, *data, ret, get_cycles() - start);
+	return ret;
+}
+
+/*
+ * This and the io, ec, cmos and msr selections below are single words,
+ * each read once per access, so unlike the PCI and ACPI ones they need
+ * no lock. Clients that must not race use a /dev/fwdt session.
+ */
+static u32 mem_addr;
+static ssize_t mem_read_address(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%08x\n", mem_addr);
+}
+
+static ssize_t mem_write_address(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	mem_addr = simple_strtoul(buf, NULL, 16);
+	
+	return count;
+}
+
+static DEVICE_ATTR(mem_address, S_IRUGO | S_IWUSR,
+		mem_read_address, mem_write_address);
+
+static ssize_t mem_read_data(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	u64 data;
+
+	if (fwdt_mem_access(GET_DATA_DWORD, mem_addr, &data))
+		return -EIO;
+
+	return sprintf(buf, "0x%08x\n", (u32) data);
+}
+
+static ssize_t mem_write_data(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	u64 data;
+
+	data = simple_strtoul(buf, NULL, 16) & 0xFFFFFFFF;
+
+	if (fwdt_mem_access(SET_DATA_DWORD, mem_addr, &data))
+		return -EIO;
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_data, S_IRUGO | S_IWUSR, mem_read_data, mem_write_data);
+
+static ssize_t mem_read_cache(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	ssize_t len;
+
+	mutex_lock(&iomap_lock);
+	len = sprintf(buf, "entries: %u\nhits: %llu\nmisses: %llu\n",
+		      iomap_entries, iomap_hits, iomap_misses);
+	mutex_unlock(&iomap_lock);
+
+	return len;
+}
+
+static ssize_t mem_write_cache(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	fwdt_iomap_flush();
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_cache, S_IRUGO | S_IWUSR, mem_read_cache, mem_write_cache);
+
+static u16 iow_addr;
+static ssize_t iow_read_address(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%04x\n", iow_addr);
+}
+
+static ssize_t iow_write_address(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	iow_addr = simple_strtoul(buf, NULL, 16) & 0xFFFF;
+	
+	return count;
+}
+
+static DEVICE_ATTR(iow_address, S_IRUGO | S_IWUSR,
+		iow_read_address, iow_write_address);
+
+static ssize_t iow_read_data(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	u64 data = 0;
+
+	fwdt_io_access(GET_DATA_WORD, iow_addr, &data);
+	return sprintf(buf, "0x%04x\n", (u16) data);
+}
+
+static ssize_t iow_write_data(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	u64 data;
+
+	data = simple_strtoul(buf, NULL, 16) & 0xFFFF;
+	fwdt_io_access(SET_DATA_WORD, iow_addr, &data);
+	
+	return count;
+}
+
+static DEVICE_ATTR(iow_data, S_IRUGO | S_IWUSR, iow_read_data, iow_write_data);
+
+static u16 iob_addr;
+static ssize_t iob_read_address(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%04x\n", iob_addr);
+}
+
+static ssize_t iob_write_address(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	iob_addr = simple_strtoul(buf, NULL, 16) & 0xFFFF;
+	
+	return count;
+}
+
+static DEVICE_ATTR(iob_address, S_IRUGO | S_IWUSR,
+		iob_read_address, iob_write_address);
+
+static ssize_t iob_read_data(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	u64 data = 0;
+
+	fwdt_io_access(GET_DATA_BYTE, iob_addr, &data);
+	return sprintf(buf, "0x%02x\n", (u8) data);
+}
+
+static ssize_t iob_write_data(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	u64 data;
+
+	data = simple_strtoul(buf, NULL, 16) & 0xFF;
+	fwdt_io_access(SET_DATA_BYTE, iob_addr, &data);
+	
+	return count;
+}
+
+static DEVICE_ATTR(iob_data, S_IRUGO | S_IWUSR, iob_read_data, iob_write_data);
+
+struct fwdt_pci_sel {
+	u16 vid;
+	u16 did;
+	u8 offset;
+};
+
+/* vid and did change together, so accessors work on a copy */
+static DEFINE_MUTEX(pci_sel_lock);
+static struct fwdt_pci_sel pci_dev;
+
+static struct fwdt_pci_sel pci_get_sel(void)
+{
+	struct fwdt_pci_sel sel;
+
+	mutex_lock(&pci_sel_lock);
+	sel = pci_dev;
+	mutex_unlock(&pci_sel_lock);
+
+	return sel;
+}
+
+static ssize_t pci_read_config_data(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct fwdt_pci_sel sel = pci_get_sel();
+	struct pci_dev *pdev = NULL;
+	u64 data = 0;
+
+	pdev = pci_get_subsys(sel.vid, sel.did,
+				PCI_ANY_ID, PCI_ANY_ID, NULL);
+	if (pdev == NULL) {
+		pr_info("pci device [%04x:%04x] is not found\n", 
+			sel.vid, sel.did);
+		return -EINVAL;
+	}
+
+	fwdt_pci_dev_access(pdev, GET_DATA_DWORD, sel.offset, &data);
+	pci_dev_put(pdev);
+
+	return sprintf(buf, "0x%08x\n", (u32) data);;
+}
+
+static ssize_t pci_write_config_data(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fwdt_pci_sel sel = pci_get_sel();
+	struct pci_dev *pdev = NULL;
+	u64 data;
+
+	data = simple_strtoul(buf, NULL, 16) & 0xFFFFFFFF;
+	pdev = pci_get_subsys(sel.vid, sel.did,
+				PCI_ANY_ID, PCI_ANY_ID, NULL);
+	if (pdev) {
+		fwdt_pci_dev_access(pdev, SET_DATA_DWORD, sel.offset,
+				    &data);
+		pci_dev_put(pdev);
+	} else
+		pr_info("pci device [%04x:%04x] is not found\n", 
+			sel.vid, sel.did);
+
+	return count;
+}
+
+static DEVICE_ATTR(pci_data, S_IRUGO | S_IWUSR,
+		pci_read_config_data, pci_write_config_data);
+
+static ssize_t pci_read_config_offset(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%x\n", pci_get_sel().offset);
+}
+
+static ssize_t pci_write_config_offset(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	mutex_lock(&pci_sel_lock);
+	pci_dev.offset = simple_strtoul(buf, NULL, 16) & 0xFF;
+	mutex_unlock(&pci_sel_lock);
+	return count;
+}
+
+static DEVICE_ATTR(pci_reg, S_IRUGO | S_IWUSR,
+		pci_read_config_offset, pci_write_config_offset);
+
+static ssize_t pci_read_hardware_ids(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct fwdt_pci_sel sel = pci_get_sel();
+
+	if (sel.vid == 0xFFFF || sel.did == 0xFFFF)
+		strcpy(buf,"ex. 8086:1c2d\n");
+	else
+		sprintf(buf, "%04x:%04x\n", sel.vid, sel.did);
+
+	return strlen(buf);
+}
+
+static ssize_t pci_write_hardware_ids(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int vendor_id, device_id;
+
+	if (strlen(buf) > 10)
+		return 0;
+
+	sscanf(buf, "%4x:%4x\n", &vendor_id, &device_id);
+
+	mutex_lock(&pci_sel_lock);
+	pci_dev.did = device_id;
+	pci_dev.vid = vendor_id;
+	mutex_unlock(&pci_sel_lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(pci_id, S_IRUGO | S_IWUSR,
+	pci_read_hardware_ids, pci_write_hardware_ids);
+
+static acpi_handle ec_device = NULL;
+static int ec_offset;
+static ssize_t acpi_read_ec_data(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	u64 data;
+
+	if (fwdt_ec_access(GET_DATA_BYTE, ec_offset, &data))
+		return -EINVAL;
+
+	return sprintf(buf, "%x\n", (u8) data);;
+}
+
+static ssize_t acpi_write_ec_data(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	u64 data;
+
+	data = simple_strtoul(buf, NULL, 16) & 0xFF;
+	if (fwdt_ec_access(SET_DATA_BYTE, ec_offset, &data))
+		return -EINVAL;
+
+	return count;
+}
+
+static DEVICE_ATTR(ec_data, S_IRUGO | S_IWUSR,
+		acpi_read_ec_data, acpi_write_ec_data);
+
+static ssize_t acpi_read_ec_addr(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%02x\n", ec_offset);;
+}
+
+static ssize_t acpi_write_ec_addr(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	ec_offset = simple_strtoul(buf, NULL, 16);
+	return count;
+}
+
+static DEVICE_ATTR(ec_address, S_IRUGO | S_IWUSR,
+		acpi_read_ec_addr, acpi_write_ec_addr);
+
+/*
+ * ACPI event capture. Producers (notify handlers, ec_qmethod) claim a
+ * slot by advancing acpi_event_head and publish it by setting its seq;
+ * the single reader consumes slots in order up to the first unpublished
+ * one, so nothing here takes a lock.
+ */
+#define FWDT_ACPI_EVENT_RING	1024
+
+struct fwdt_acpi_event_slot {
+	u32			seq;		/* position + 1 once written */
+	struct fwdt_acpi_event	ev;
+};
+
+static struct fwdt_acpi_event_slot acpi_event_ring[FWDT_ACPI_EVENT_RING];
+static atomic_t acpi_event_head = ATOMIC_INIT(0);
+static u32 acpi_event_tail;
+static atomic_long_t acpi_events_dropped;
+static bool acpi_events_enabled;
+static u32 acpi_event_ec_gpe = FWDT_ACPI_EVENT_NO_EC_GPE;
+static DECLARE_WAIT_QUEUE_HEAD(acpi_event_wait);
+
+static void fwdt_acpi_event_post(u32 type, u32 value, u32 ec_gpe,
+				 const char *path)
+{
+	struct fwdt_acpi_event_slot *slot;
+	int head;
+
+	if (!ACCESS_ONCE(acpi_events_enabled))
+		return;
+
+	do {
+		head = atomic_read(&acpi_event_head);
+		if ((u32) head - ACCESS_ONCE(acpi_event_tail) >=
+		    FWDT_ACPI_EVENT_RING) {
+			atomic_long_inc(&acpi_events_dropped);
+			return;
+		}
+	} while (atomic_cmpxchg(&acpi_event_head, head, head + 1) != head);
+
+	slot = &acpi_event_ring[(u32) head % FWDT_ACPI_EVENT_RING];
+	slot->ev.timestamp = ktime_to_ns(ktime_get());
+	slot->ev.type = type;
+	slot->ev.value = value;
+	slot->ev.ec_gpe = ec_gpe;
+	slot->ev.reserved = 0;
+	strlcpy(slot->ev.path, path, sizeof(slot->ev.path));
+
+	smp_wmb();
+	ACCESS_ONCE(slot->seq) = (u32) head + 1;
+
+	wake_up_interruptible(&acpi_event_wait);
+}
+
+/* context is the path of a registered device, NULL for the root handler */
+static void fwdt_acpi_event_notify(acpi_handle handle, u32 event,
+				   void *context)
+{
+	struct acpi_buffer name;
+	char path[64];
+
+	if (!context) {
+		name.length = sizeof(path);
+		name.pointer = path;
+		if (!ACPI_SUCCESS(acpi_get_name(handle, ACPI_FULL_PATHNAME,
+						&name)))
+			strcpy(path, "?");
+		context = path;
+	}
+
+	fwdt_acpi_event_post(FWDT_ACPI_EVENT_NOTIFY, event,
+			     handle == ec_device ? acpi_event_ec_gpe :
+			     FWDT_ACPI_EVENT_NO_EC_GPE, context);
+}
+
+static ssize_t acpi_write_ec_qxx(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	acpi_status status;
+	u8 data;
+	char q_num[5];
+
+	data = simple_strtoul(buf, NULL, 16);
+	sprintf(q_num, "_Q%02X", data);
+
+	status = fwdt_acpi_evaluate(ec_device, NULL, q_num, NULL, NULL);
+	fwdt_acpi_event_post(FWDT_ACPI_EVENT_EC_QMETHOD, data,
+			     acpi_event_ec_gpe, q_num);
+	if (ACPI_SUCCESS(status))
+		printk("Executed %s\n", q_num);
+	else
+		printk("Failed to execute %s\n", q_num);
+
+	return count;
+}
+
+static DEVICE_ATTR(ec_qmethod, S_IWUSR, NULL, acpi_write_ec_qxx);
+
+/* EC commands, see ACPI spec 12.3 */
+#define FWDT_EC_BURST_ENABLE	0x82
+#define FWDT_EC_BURST_DISABLE	0x83
+#define FWDT_EC_BURST_ACK	0x90
+#define FWDT_EC_SIZE		256
+
+static DEFINE_MUTEX(ec_range_lock);
+
+/*
+ * Read or write a range of EC RAM with the EC held in burst mode, so it
+ * services the whole range back to back instead of byte by byte.
+ */
+static int fwdt_ec_range(u16 func, unsigned int offset, u8 *buf,
+			 size_t length)
+{
+	bool burst;
+	u8 ack;
+	int err = 0;
+	cycles_t start;
+	int i;
+
+	if (offset + length > FWDT_EC_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&ec_range_lock);
+	start = get_cycles();
+	/* an EC that refuses burst mode answers with something else */
+	burst = !ec_transaction(FWDT_EC_BURST_ENABLE, NULL, 0, &ack, 1) &&
+		ack == FWDT_EC_BURST_ACK;
+
+	for (i = 0; i < length && !err; i++) {
+		if (func == READ_EC_RANGE)
+			err = ec_read(offset + i, &buf[i]);
+		else
+			err = ec_write(offset + i, buf[i]);
+	}
+
+	if (burst)
+		ec_transaction(FWDT_EC_BURST_DISABLE, NULL, 0, NULL, 0);
+	start = get_cycles() - start;
+	mutex_unlock(&ec_range_lock);
+
+	trace_fwdt_ec_range(func, 0, offset, length, err, start);
+	return err;
+}
+
+static ssize_t ec_bin_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	if (fwdt_ec_range(READ_EC_RANGE, off, (u8 *) buf, count))
+		return -EIO;
+
+	return count;
+}
+
+static ssize_t ec_bin_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	if (fwdt_ec_range(WRITE_EC_RANGE, off, (u8 *) buf, count))
+		return -EIO;
+
+	return count;
+}
+
+static struct bin_attribute bin_attr_ec = {
+	.attr	= { .name = "ec", .mode = S_IRUGO | S_IWUSR },
+	.size	= FWDT_EC_SIZE,
+	.read	= ec_bin_read,
+	.write	= ec_bin_write,
+};
+
+static int cmos_offset;
+static ssize_t cmos_read_data(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	u8 data;
+
+	if (fwdt_cmos_range(READ_CMOS_RANGE, cmos_offset, &data, 1))
+		return -EINVAL;
+
+	return sprintf(buf, "0x%02x\n", data);
+}
+
+static ssize_t cmos_write_addr(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	if (kstrtoint(buf, 16, &cmos_offset))
+		return -EINVAL;
+	return count;
+}
+
+static DEVICE_ATTR(cmos, S_IRUGO | S_IWUSR, cmos_read_data, cmos_write_addr);
+
+/*
+ * nvram holds the whole NVRAM, extended bank included, at its register
+ * offsets; the cmos name is taken by the index/data attribute above.
+ */
+static ssize_t cmos_bin_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	if (fwdt_cmos_range(READ_CMOS_RANGE, off, (u8 *) buf, count))
+		return -EIO;
+
+	return count;
+}
+
+static ssize_t cmos_bin_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	if (fwdt_cmos_range(WRITE_CMOS_RANGE, off, (u8 *) buf, count))
+		return -EIO;
+
+	return count;
+}
+
+static struct bin_attribute bin_attr_nvram = {
+	.attr	= { .name = "nvram", .mode = S_IRUGO | S_IWUSR },
+	.size	= FWDT_CMOS_SIZE,
+	.read	= cmos_bin_read,
+	.write	= cmos_bin_write,
+};
+
+static int msr_register;
+static ssize_t msr_read_data(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	u64 data = 0;
+	int cpu;
+
+	cpu = get_cpu();
+	put_cpu();
+	if (fwdt_msr_access(GET_DATA_QWORD, cpu, msr_register, &data))
+		return -EIO;
+
+	return sprintf(buf, "0x%016llx\n", data);
+}
+
+static ssize_t msr_set_register(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	if (kstrtoint(buf, 16, &msr_register))
+		return -EINVAL;
+	return count;
+}
+
+static DEVICE_ATTR(msr, S_IRUGO | S_IWUSR, msr_read_data, msr_set_register);
+
+static void fwdt_io_range(u16 func, u16 port, u8 width, void *buf, u32 count)
+{
+	u8 *b = buf;
+	u16 *w = buf;
+	u32 *d = buf;
+	cycles_t start;
+	u32 i;
+
+	start = get_cycles();
+	switch (func) {
+	case READ_IO_FIFO:
+		if (width == 1)
+			insb(port, buf, count);
+		else if (width == 2)
+			insw(port, buf, count);
+		else
+			insl(port, buf, count);
+		break;
+	case WRITE_IO_FIFO:
+		if (width == 1)
+			outsb(port, buf, count);
+		else if (width == 2)
+			outsw(port, buf, count);
+		else
+			outsl(port, buf, count);
+		break;
+	case READ_IO_RANGE:
+		for (i = 0; i < count; i++, port += width) {
+			if (width == 1)
+				b[i] = inb(port);
+			else if (width == 2)
+				w[i] = inw(port);
+			else
+				d[i] = inl(port);
+		}
+		break;
+	case WRITE_IO_RANGE:
+		for (i = 0; i < count; i++, port += width) {
+			if (width == 1)
+				outb(b[i], port);
+			else if (width == 2)
+				outw(w[i], port);
+			else
+				outl(d[i], port);
+		}
+		break;
+	}
+
+	trace_fwdt_io_range(func, width, port, count, 0, get_cycles() - start);
+}
+
+/*
+ * The io file maps the IO space: the file offset is the port. Each
+ * transfer uses the widest access its offset and length are aligned to.
+ */
+static ssize_t io_bin_rw(u16 func, char *buf, loff_t off, size_t count)
+{
+	u8 width = 1;
+
+	if (!(off & 3) && !(count & 3))
+		width = 4;
+	else if (!(off & 1) && !(count & 1))
+		width = 2;
+
+	fwdt_io_range(func, off, width, buf, count / width);
+
+	return count;
+}
+
+static ssize_t io_bin_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	return io_bin_rw(READ_IO_RANGE, buf, off, count);
+}
+
+static ssize_t io_bin_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	return io_bin_rw(WRITE_IO_RANGE, buf, off, count);
+}
+
+static struct bin_attribute bin_attr_io = {
+	.attr	= { .name = "io", .mode = S_IRUSR | S_IWUSR },
+	.size	= 0x10000,
+	.read	= io_bin_read,
+	.write	= io_bin_write,
+};
+
+static int fwdt_hw_ec_range(u16 func, unsigned int offset, u8 *buf,
+			    size_t length)
+{
+	if (!ec_device)
+		return -ENODEV;
+
+	return fwdt_ec_range(func, offset, buf, length);
+}
+
+static int fwdt_hw_acpi_lookup(const char *path, void **handle)
+{
+	return fwdt_get_acpi_handle(path, (acpi_handle *) handle);
+}
+
+static int fwdt_hw_acpi_integer(void *handle, const char *path,
+				const char *method, u64 *arg, u64 *result)
+{
+	union acpi_object arg0 = { ACPI_TYPE_INTEGER };
+	struct acpi_object_list args = { 1, &arg0 };
+	unsigned long long data;
+	acpi_status status;
+
+	if (arg)
+		arg0.integer.value = *arg;
+	if (!result)
+		return fwdt_acpi_evaluate(handle, path, (char *) method,
+					  arg ? &args : NULL, NULL);
+
+	status = fwdt_acpi_evaluate_integer(handle, path, (char *) method,
+					    arg ? &args : NULL, &data);
+	if (ACPI_SUCCESS(status))
+		*result = data;
+
+	return status;
+}
+
+static int fwdt_hw_br_levels(void *handle, u32 *levels, u32 *num_of_levels)
+{
+	return fwdt_get_br_levels(handle, levels, num_of_levels);
+}
+
+/* the real hardware behind the handlers shared with fwdt_core.c */
+static const struct fwdt_backend fwdt_hw_backend = {
+	.io		= fwdt_io_access,
+	.io_range	= fwdt_io_range,
+	.mem		= fwdt_mem_access,
+	.cmos		= fwdt_cmos_access,
+	.cmos_range	= fwdt_cmos_range,
+	.pci		= fwdt_pci_access,
+	.ec		= fwdt_ec_access,
+	.ec_range	= fwdt_hw_ec_range,
+	.msr		= fwdt_msr_access,
+	.acpi_lookup	= fwdt_hw_acpi_lookup,
+	.acpi_integer	= fwdt_hw_acpi_integer,
+	.br_levels	= fwdt_hw_br_levels,
+};
+
+static int handle_iomap_cache_cmd(fwdt_generic __user *fg)
+{
+	struct fwdt_iomap_cache fic;
+	int ret = 0;
+
+	if (copy_from_user(&fic, fg, sizeof(fic)))
+		return -EFAULT;
+
+	switch (fic.parameters.func) {
+	case GET_IOMAP_STATS:
+		mutex_lock(&iomap_lock);
+		fic.entries = iomap_entries;
+		fic.hits = iomap_hits;
+		fic.misses = iomap_misses;
+		mutex_unlock(&iomap_lock);
+		break;
+	case FLUSH_IOMAP_CACHE:
+		fwdt_iomap_flush();
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+
+	fic.parameters.func_status = FWDT_SUCCESS;
+	if (copy_to_user(fg, &fic, sizeof(fic)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
+static struct {
+	u64 base;
+	u64 size;
+} mmap_windows[FWDT_MMAP_MAX_WINDOWS];
+static DEFINE_MUTEX(mmap_windows_lock);
+
+static int handle_mmap_window_cmd(fwdt_generic __user *fg)
+{
+	struct fwdt_mmap_window fw;
+	int ret = 0;
+	int i;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (copy_from_user(&fw, fg, sizeof(fw)))
+		return -EFAULT;
+
+	mutex_lock(&mmap_windows_lock);
+	switch (fw.parameters.func) {
+	case ADD_MMAP_WINDOW:
+		fw.parameters.func_status = FWDT_FAIL;
+		if (!fw.size || fw.base + fw.size < fw.base ||
+		    (fw.base | fw.size) & ~PAGE_MASK)
+			break;
+		for (i = 0; i < FWDT_MMAP_MAX_WINDOWS; i++) {
+			if (mmap_windows[i].size)
+				continue;
+			mmap_windows[i].base = fw.base;
+			mmap_windows[i].size = fw.size;
+			fw.parameters.func_status = FWDT_SUCCESS;
+			break;
+		}
+		break;
+	case DEL_MMAP_WINDOW:
+		fw.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		for (i = 0; i < FWDT_MMAP_MAX_WINDOWS; i++) {
+			if (mmap_windows[i].base != fw.base ||
+			    mmap_windows[i].size != fw.size)
+				continue;
+			mmap_windows[i].size = 0;
+			fw.parameters.func_status = FWDT_SUCCESS;
+			break;
+		}
+		break;
+	case CLEAR_MMAP_WINDOWS:
+		memset(mmap_windows, 0, sizeof(mmap_windows));
+		fw.parameters.func_status = FWDT_SUCCESS;
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	if (copy_to_user(fg, &fw, sizeof(fw)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&mmap_windows_lock);
+	return ret;
+}
+
+/*
+ * A range may be mapped only if it sits entirely inside one window set up
+ * through FWDT_MMAP_WINDOW_CMD and does not cover any system RAM, which
+ * must never be mapped uncached alongside the kernel's cached mapping.
+ */
+static bool fwdt_mmap_allowed(u64 base, u64 size)
+{
+	bool allowed = false;
+	u64 pfn;
+	int i;
+
+	if (base + size < base)
+		return false;
+
+	mutex_lock(&mmap_windows_lock);
+	for (i = 0; i < FWDT_MMAP_MAX_WINDOWS; i++) {
+		if (!mmap_windows[i].size)
+			continue;
+		if (base >= mmap_windows[i].base &&
+		    base + size <= mmap_windows[i].base + mmap_windows[i].size) {
+			allowed = true;
+			break;
+		}
+	}
+	mutex_unlock(&mmap_windows_lock);
+
+	if (!allowed)
+		return false;
+
+	for (pfn = base >> PAGE_SHIFT; pfn < (base + size) >> PAGE_SHIFT; pfn++)
+		if (page_is_ram(pfn))
+			return false;
+
+	return true;
+}
+
+static int fwdt_runtime_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fwdt_file *ff = file->private_data;
+	u64 size = vma->vm_end - vma->vm_start;
+	u64 base = (u64) vma->vm_pgoff << PAGE_SHIFT;
+
+	/* once a sampler runs on this file, mmap() maps its rings instead */
+	if (ACCESS_ONCE(ff->sampler))
+		return fwdt_sampler_mmap(ff->sampler, vma);
+	if (ACCESS_ONCE(ff->ring))
+		return fwdt_ring_mmap(ff->ring, vma);
+
+	if (!capable(CAP_SYS_RAWIO))
+		return -EPERM;
+
+	if (!fwdt_mmap_allowed(base, size)) {
+		pr_info("mmap of 0x%llx-0x%llx denied\n", base, base + size - 1);
+		return -EPERM;
+	}
+
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+
+	if (io_remap_pfn_range(vma, vma->vm_start, vma->vm_pgoff, size,
+			       vma->vm_page_prot))
+		return -EAGAIN;
+
+	return 0;
+}
+
+static int fwdt_pci_config_range(struct pci_dev *pdev, u16 func, u16 offset,
+				 u8 *buf, u16 length)
+{
+	int pos = offset;
+	int end = offset + length;
+	int err = 0;
+	cycles_t start;
+	u32 d;
+	u16 w;
+	u8 b;
+
+	start = get_cycles();
+	while (pos < end && !err) {
+		if (!(pos & 3) && end - pos >= 4) {
+			if (func == READ_PCI_CONFIG) {
+				err = pci_read_config_dword(pdev, pos, &d);
+				memcpy(buf + pos - offset, &d, 4);
+			} else {
+				memcpy(&d, buf + pos - offset, 4);
+				err = pci_write_config_dword(pdev, pos, d);
+			}
+			pos += 4;
+		} else if (!(pos & 1) && end - pos >= 2) {
+			if (func == READ_PCI_CONFIG) {
+				err = pci_read_config_word(pdev, pos, &w);
+				memcpy(buf + pos - offset, &w, 2);
+			} else {
+				memcpy(&w, buf + pos - offset, 2);
+				err = pci_write_config_word(pdev, pos, w);
+			}
+			pos += 2;
+		} else {
+			if (func == READ_PCI_CONFIG) {
+				err = pci_read_config_byte(pdev, pos, &b);
+				buf[pos - offset] = b;
+			} else {
+				err = pci_write_config_byte(pdev, pos, buf[pos - offset]);
+			}
+			pos++;
+		}
+	}
+	start = get_cycles() - start;
+
+	trace_fwdt_pci_range(func, FWDT_PCI_DEVICE(pci_domain_nr(pdev->bus),
+						   pdev->bus->number,
+						   PCI_SLOT(pdev->devfn),
+						   PCI_FUNC(pdev->devfn)),
+			     offset, length, err, start);
+	return err ? FWDT_FAIL : FWDT_SUCCESS;
+}
+
+/*
+ * pci_config lays out segment 0 the way ECAM does: the file offset is
+ * bus << 20 | devfn << 12 | register. Reads of absent functions or past
+ * a function's config space return all ones, writes to them fail.
+ */
+#define FWDT_PCI_BIN_SIZE	(256 << 20)
+
+static ssize_t pci_config_bin_rw(u16 func, char *buf, loff_t off,
+				 size_t count)
+{
+	struct pci_dev *pdev;
+	size_t done, n;
+	u16 reg;
+	int ret;
+
+	for (done = 0; done < count; done += n) {
+		reg = (off + done) & 0xFFF;
+		n = min_t(size_t, count - done, FWDT_PCI_CONFIG_SIZE - reg);
+
+		pdev = pci_get_domain_bus_and_slot(0, (off + done) >> 20,
+						   ((off + done) >> 12) & 0xFF);
+		if (!pdev || reg >= pdev->cfg_size) {
+			pci_dev_put(pdev);
+			if (func == WRITE_PCI_CONFIG)
+				return done ? done : -ENODEV;
+			memset(buf + done, 0xFF, n);
+			continue;
+		}
+
+		if (reg + n > pdev->cfg_size) {
+			if (func == READ_PCI_CONFIG)
+				memset(buf + done + pdev->cfg_size - reg, 0xFF,
+				       reg + n - pdev->cfg_size);
+			else
+				n = pdev->cfg_size - reg;
+		}
+
+		ret = fwdt_pci_config_range(pdev, func, reg, (u8 *) buf + done,
+					    min_t(size_t, n, pdev->cfg_size - reg));
+		pci_dev_put(pdev);
+		if (ret)
+			return done ? done : -EIO;
+	}
+
+	return count;
+}
+
+static ssize_t pci_config_bin_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	return pci_config_bin_rw(READ_PCI_CONFIG, buf, off, count);
+}
+
+static ssize_t pci_config_bin_write(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	return pci_config_bin_rw(WRITE_PCI_CONFIG, buf, off, count);
+}
+
+static struct bin_attribute bin_attr_pci_config = {
+	.attr	= { .name = "pci_config", .mode = S_IRUGO | S_IWUSR },
+	.size	= FWDT_PCI_BIN_SIZE,
+	.read	= pci_config_bin_read,
+	.write	= pci_config_bin_write,
+};
+
+/* must be called with ff->lock held */
+static struct pci_dev *fwdt_file_pci_dev(struct fwdt_file *ff, u32 device)
+{
+	if (ff->pdev && ff->pci_device == device)
+		return ff->pdev;
+
+	pci_dev_put(ff->pdev);
+	ff->pdev = pci_get_domain_bus_and_slot(device >> 16,
+					       (device >> 8) & 0xFF,
+					       device & 0xFF);
+	ff->pci_device = device;
+
+	return ff->pdev;
+}
+
+/* fill mask from a user bitmap of u64 words, bit n selecting CPU n */
+static int fwdt_cpumask_from_user(struct cpumask *mask, u64 uptr,
+				  u32 num_cpus)
+{
+	size_t size = DIV_ROUND_UP(num_cpus, 64) * sizeof(u64);
+	u64 *bitmap;
+	int cpu;
+
+	bitmap = kmalloc(size, GFP_KERNEL);
+	if (!bitmap)
+		return -ENOMEM;
+
+	if (copy_from_user(bitmap, (void __user *) (unsigned long) uptr, size)) {
+		kfree(bitmap);
+		return -EFAULT;
+	}
+
+	for (cpu = 0; cpu < num_cpus; cpu++)
+		if (bitmap[cpu / 64] & (1ULL << (cpu % 64)))
+			cpumask_set_cpu(cpu, mask);
+
+	kfree(bitmap);
+	return 0;
+}
+
+struct fwdt_msr_matrix_info {
+	u16	func;
+	u32	num_msrs;
+	u32	*msrs;
+	u64	*values;
+	int	*status;
+};
+
+/* runs on every selected CPU, filling in that CPU's row of the matrix */
+static void fwdt_msr_matrix_cpu(void *data)
+{
+	struct fwdt_msr_matrix_info *info = data;
+	int cpu = smp_processor_id();
+	u64 *row = info->values + cpu * info->num_msrs;
+	int err = 0;
+	int i;
+
+	for (i = 0; i < info->num_msrs; i++) {
+		if (info->func == READ_MSR_MATRIX)
+			err |= rdmsrl_safe(info->msrs[i], &row[i]);
+		else
+			err |= wrmsrl_safe(info->msrs[i], row[i]);
+	}
+
+	info->status[cpu] = err ? FWDT_FAIL : FWDT_SUCCESS;
+}
+
+static int handle_msr_matrix_cmd(fwdt_generic __user *fg)
+{
+	struct fwdt_msr_matrix fmm;
+	struct fwdt_msr_matrix_info info = { 0 };
+	cpumask_var_t mask;
+	size_t values_size;
+	u32 num_cpus;
+	int cpu;
+	int ret = 0;
+
+	if (copy_from_user(&fmm, fg, sizeof(fmm)))
+		return -EFAULT;
+
+	info.func = fmm.parameters.func;
+	if (info.func != READ_MSR_MATRIX && info.func != WRITE_MSR_MATRIX)
+		return FWDT_FUNC_NOT_SUPPORTED;
+
+	if (!fmm.num_msrs || fmm.num_msrs > FWDT_MSR_MAX_REGS || !fmm.num_cpus)
+		return -EINVAL;
+
+	/* rows beyond the CPUs this kernel can have are left alone */
+	num_cpus = min_t(u32, fmm.num_cpus, nr_cpu_ids);
+	values_size = (size_t) num_cpus * fmm.num_msrs * sizeof(u64);
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	info.num_msrs = fmm.num_msrs;
+	info.msrs = kmalloc(fmm.num_msrs * sizeof(u32), GFP_KERNEL);
+	info.status = kmalloc(num_cpus * sizeof(int), GFP_KERNEL);
+	info.values = vzalloc(values_size);
+	if (!info.msrs || !info.status || !info.values) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(info.msrs, (void __user *) (unsigned long) fmm.msrs,
+			   fmm.num_msrs * sizeof(u32))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	ret = fwdt_cpumask_from_user(mask, fmm.cpu_mask, num_cpus);
+	if (ret)
+		goto out;
+
+	if (info.func == WRITE_MSR_MATRIX &&
+	    copy_from_user(info.values,
+			   (void __user *) (unsigned long) fmm.values,
+			   values_size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (cpu = 0; cpu < num_cpus; cpu++)
+		info.status[cpu] = FWDT_DEVICE_NOT_FOUND;
+
+	/* one IPI round; offline CPUs in the mask keep FWDT_DEVICE_NOT_FOUND */
+	get_online_cpus();
+	on_each_cpu_mask(mask, fwdt_msr_matrix_cpu, &info, true);
+	put_online_cpus();
+
+	if (copy_to_user((void __user *) (unsigned long) fmm.status, info.status,
+			 num_cpus * sizeof(int)) ||
+	    (info.func == READ_MSR_MATRIX &&
+	     copy_to_user((void __user *) (unsigned long) fmm.values,
+			  info.values, values_size))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	fmm.num_cpus = num_cpus;
+	fmm.parameters.func_status = FWDT_SUCCESS;
+	if (copy_to_user(fg, &fmm, sizeof(fmm)))
+		ret = -EFAULT;
+ out:
+	vfree(info.values);
+	kfree(info.status);
+	kfree(info.msrs);
+	free_cpumask_var(mask);
+	return ret;
+}
+
+#define FWDT_SAMPLER_MIN_PERIOD_NS	10000
+#define FWDT_SAMPLER_MAX_RING_SIZE	65536
+
+/*
+ * The ring header is mapped writable into userspace, so the producer
+ * keeps its own size and head and only publishes them there.
+ */
+struct fwdt_sampler_cpu {
+	struct hrtimer			timer;
+	struct fwdt_sampler		*sampler;
+	struct fwdt_sample_ring		*ring;
+	u32				size;
+	u32				head;
+};
+
+/*
+ * An MSR sampler belongs to one open file. Each selected CPU has a pinned
+ * hrtimer that is the only producer of its ring; read() or an mmap()ed
+ * consumer is the only consumer. The rings live in one vmalloc area that
+ * is mapped into userspace as is.
+ */
+struct fwdt_sampler {
+	ktime_t				period;
+	u32				num_msrs;
+	u32				msrs[FWDT_SAMPLER_MAX_MSRS];
+	int				num_rings;
+	size_t				ring_bytes;
+	void				*area;
+	struct fwdt_sampler_cpu		*cpus;
+	bool				running;
+	int				next_ring;
+	struct mutex			read_lock;
+	wait_queue_head_t		wait;
+};
+
+static enum hrtimer_restart fwdt_sampler_tick(struct hrtimer *timer)
+{
+	struct fwdt_sampler_cpu *sc;
+	struct fwdt_sample_ring *ring;
+	struct fwdt_msr_sample *sample;
+	struct fwdt_sampler *s;
+	u32 head;
+	u64 value;
+	int i;
+
+	sc = container_of(timer, struct fwdt_sampler_cpu, timer);
+	s = sc->sampler;
+	ring = sc->ring;
+
+	hrtimer_forward_now(timer, s->period);
+
+	head = sc->head;
+	if (head - ACCESS_ONCE(ring->tail) >= sc->size) {
+		ring->dropped++;
+		return HRTIMER_RESTART;
+	}
+	/* don't overwrite the slot before the consumer is done with it */
+	smp_mb();
+
+	sample = &ring->samples[head & (sc->size - 1)];
+	sample->tsc = get_cycles();
+	sample->cpu = smp_processor_id();
+	sample->num_msrs = s->num_msrs;
+	for (i = 0; i < s->num_msrs; i++) {
+		if (rdmsrl_safe(s->msrs[i], &value))
+			value = 0;
+		sample->values[i] = value;
+	}
+
+	smp_wmb();
+	ACCESS_ONCE(sc->head) = head + 1;
+	ACCESS_ONCE(ring->head) = head + 1;
+
+	wake_up_interruptible(&s->wait);
+
+	return HRTIMER_RESTART;
+}
+
+static void fwdt_sampler_start_cpu(void *data)
+{
+	struct fwdt_sampler_cpu *sc = data;
+
+	hrtimer_start(&sc->timer, sc->sampler->period,
+		      HRTIMER_MODE_REL_PINNED);
+}
+
+static void fwdt_sampler_stop(struct fwdt_sampler *s)
+{
+	int i;
+
+	if (!s->running)
+		return;
+
+	for (i = 0; i < s->num_rings; i++)
+		hrtimer_cancel(&s->cpus[i].timer);
+
+	/* readers that see running clear drain once more, then hit EOF */
+	smp_wmb();
+	ACCESS_ONCE(s->running) = false;
+	wake_up_interruptible(&s->wait);
+}
+
+static void fwdt_sampler_free(struct fwdt_sampler *s)
+{
+	if (!s)
+		return;
+
+	fwdt_sampler_stop(s);
+	vfree(s->area);
+	kfree(s->cpus);
+	kfree(s);
+}
+
+static int fwdt_sampler_mmap(struct fwdt_sampler *s,
+			     struct vm_area_struct *vma)
+{
+	return remap_vmalloc_range(vma, s->area, vma->vm_pgoff);
+}
+
+static bool fwdt_sampler_pending(struct fwdt_sampler *s)
+{
+	struct fwdt_sampler_cpu *sc;
+	int i;
+
+	for (i = 0; i < s->num_rings; i++) {
+		sc = &s->cpus[i];
+		if (ACCESS_ONCE(sc->head) != ACCESS_ONCE(sc->ring->tail))
+			return true;
+	}
+
+	return false;
+}
+
+static struct fwdt_sampler *fwdt_sampler_create(struct fwdt_msr_sampler *fms,
+						const struct cpumask *mask)
+{
+	struct fwdt_sampler *s;
+	struct fwdt_sampler_cpu *sc;
+	struct fwdt_sample_ring *ring;
+	int cpu, i;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return NULL;
+
+	s->period = ns_to_ktime(fms->period_ns);
+	s->num_msrs = fms->num_msrs;
+	memcpy(s->msrs, fms->msrs, sizeof(s->msrs));
+	s->num_rings = cpumask_weight(mask);
+	s->ring_bytes = PAGE_ALIGN(sizeof(*ring) +
+			fms->ring_size * sizeof(struct fwdt_msr_sample));
+	mutex_init(&s->read_lock);
+	init_waitqueue_head(&s->wait);
+
+	s->cpus = kcalloc(s->num_rings, sizeof(*s->cpus), GFP_KERNEL);
+	s->area = vmalloc_user(s->num_rings * s->ring_bytes);
+	if (!s->cpus || !s->area) {
+		fwdt_sampler_free(s);
+		return NULL;
+	}
+
+	i = 0;
+	for_each_cpu(cpu, mask) {
+		ring = s->area + i * s->ring_bytes;
+		ring->size = fms->ring_size;
+		ring->cpu = cpu;
+
+		sc = &s->cpus[i++];
+		sc->sampler = s;
+		sc->ring = ring;
+		sc->size = fms->ring_size;
+		hrtimer_init(&sc->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
+		sc->timer.function = fwdt_sampler_tick;
+	}
+
+	return s;
+}
+
+static int handle_msr_sampler_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_msr_sampler fms;
+	struct fwdt_sampler *s;
+	cpumask_var_t mask;
+	int i, ret = 0;
+
+	if (copy_from_user(&fms, fg, sizeof(fms)))
+		return -EFAULT;
+
+	mutex_lock(&ff->lock);
+	switch (fms.parameters.func) {
+	case START_MSR_SAMPLER:
+		/* a sampler is configured once per open file */
+		if (ff->sampler || ff->ring || ff->watch || ff->acpi_events ||
+		    ff->session) {
+			ret = -EBUSY;
+			goto err;
+		}
+		if (!fms.num_msrs || fms.num_msrs > FWDT_SAMPLER_MAX_MSRS ||
+		    fms.period_ns < FWDT_SAMPLER_MIN_PERIOD_NS ||
+		    !is_power_of_2(fms.ring_size) ||
+		    fms.ring_size > FWDT_SAMPLER_MAX_RING_SIZE) {
+			ret = -EINVAL;
+			goto err;
+		}
+
+		if (!zalloc_cpumask_var(&mask, GFP_KERNEL)) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		ret = fwdt_cpumask_from_user(mask, fms.cpu_mask,
+				min_t(u32, fms.num_cpus, nr_cpu_ids));
+		if (!ret && cpumask_empty(mask))
+			ret = -EINVAL;
+		if (ret) {
+			free_cpumask_var(mask);
+			goto err;
+		}
+
+		s = fwdt_sampler_create(&fms, mask);
+		free_cpumask_var(mask);
+		if (!s) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		get_online_cpus();
+		for (i = 0; i < s->num_rings; i++)
+			if (cpu_online(s->cpus[i].ring->cpu))
+				smp_call_function_single(s->cpus[i].ring->cpu,
+					fwdt_sampler_start_cpu, &s->cpus[i], 1);
+		s->running = true;
+		put_online_cpus();
+
+		smp_wmb();
+		ff->sampler = s;
+		fms.num_rings = s->num_rings;
+		fms.ring_bytes = s->ring_bytes;
+		break;
+	case STOP_MSR_SAMPLER:
+		if (!ff->sampler) {
+			fms.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		/* samples already taken can still be read */
+		fwdt_sampler_stop(ff->sampler);
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	fms.parameters.func_status = FWDT_SUCCESS;
+ out:
+	if (copy_to_user(fg, &fms, sizeof(fms)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+struct fwdt_ring_ctx {
+	struct fwdt_ring_header	*hdr;
+	struct fwdt_ring_sqe	*sqes;
+	struct fwdt_ring_cqe	*cqes;
+	u32			sq_entries;
+	u32			cq_entries;
+	bool			sqpoll;
+	unsigned long		idle;		/* jiffies */
+	size_t			ring_bytes;
+	struct task_struct	*thread;
+	wait_queue_head_t	cq_wait;
+	int			num_methods;
+	acpi_handle		methods[FWDT_RING_MAX_METHODS];
+	char			*method_paths[FWDT_RING_MAX_METHODS];
+};
+
+#define FWDT_RING_MAX_IDLE_MS	1000
+
+static int fwdt_ring_run_acpi(struct fwdt_ring_ctx *r,
+			      struct fwdt_ring_sqe *sqe, u64 *data)
+{
+	struct acpi_buffer buffer = { ACPI_ALLOCATE_BUFFER, NULL };
+	union acpi_object arg0 = { ACPI_TYPE_INTEGER };
+	struct acpi_object_list args = { 1, &arg0 };
+	union acpi_object *obj;
+	acpi_status status;
+
+	if (sqe->device >= ACCESS_ONCE(r->num_methods))
+		return FWDT_DEVICE_NOT_FOUND;
+	smp_rmb();
+
+	arg0.integer.value = *data;
+	switch (sqe->func) {
+	case GET_DATA_QWORD:
+		status = fwdt_acpi_evaluate(r->methods[sqe->device],
+					    r->method_paths[sqe->device],
+					    NULL, NULL, &buffer);
+		break;
+	case SET_DATA_QWORD:
+		status = fwdt_acpi_evaluate(r->methods[sqe->device],
+					    r->method_paths[sqe->device],
+					    NULL, &args, &buffer);
+		break;
+	default:
+		return FWDT_FUNC_NOT_SUPPORTED;
+	}
+	if (!ACPI_SUCCESS(status))
+		return FWDT_FAIL;
+
+	/* methods may return nothing or a non-integer; data is then 0 */
+	obj = buffer.pointer;
+	*data = obj && obj->type == ACPI_TYPE_INTEGER ? obj->integer.value : 0;
+	kfree(buffer.pointer);
+
+	return FWDT_SUCCESS;
+}
+
+static void fwdt_ring_run(struct fwdt_ring_ctx *r, struct fwdt_ring_sqe *sqe,
+			  struct fwdt_ring_cqe *cqe)
+{
+	struct fwdt_batch_op op;
+	struct fwdt_batch_result res;
+	u64 data = sqe->data;
+
+	if (sqe->target == FWDT_TARGET_ACPI) {
+		res.status = fwdt_ring_run_acpi(r, sqe, &data);
+		res.data = data;
+	} else {
+		op.func = sqe->func;
+		op.target = sqe->target;
+		op.device = sqe->device;
+		op.address = sqe->address;
+		op.data = sqe->data;
+		fwdt_core_run_op(&fwdt_hw_backend, &op, &res);
+	}
+
+	cqe->user_data = sqe->user_data;
+	cqe->data = res.data;
+	cqe->timestamp = ktime_to_ns(ktime_get());
+	cqe->status = res.status;
+	cqe->reserved = 0;
+}
+
+static u32 fwdt_ring_cq_ready(struct fwdt_ring_ctx *r)
+{
+	return ACCESS_ONCE(r->hdr->cq_tail) - ACCESS_ONCE(r->hdr->cq_head);
+}
+
+/* SQEs are waiting and there is room to complete them */
+static bool fwdt_ring_has_work(struct fwdt_ring_ctx *r)
+{
+	return ACCESS_ONCE(r->hdr->sq_tail) != r->hdr->sq_head &&
+	       fwdt_ring_cq_ready(r) < r->cq_entries;
+}
+
+/* consume SQEs while there is room for their completions */
+static int fwdt_ring_drain(struct fwdt_ring_ctx *r)
+{
+	struct fwdt_ring_header *hdr = r->hdr;
+	struct fwdt_ring_sqe sqe;
+	struct fwdt_ring_cqe cqe;
+	u32 sq_head = hdr->sq_head;
+	u32 cq_tail = hdr->cq_tail;
+	u32 sq_tail;
+	int done = 0;
+
+	sq_tail = ACCESS_ONCE(hdr->sq_tail);
+	smp_rmb();
+
+	while (sq_head != sq_tail &&
+	       cq_tail - ACCESS_ONCE(hdr->cq_head) < r->cq_entries) {
+		/* the submitter may scribble on the slot, work on a copy */
+		sqe = r->sqes[sq_head & (r->sq_entries - 1)];
+		fwdt_ring_run(r, &sqe, &cqe);
+		sq_head++;
+
+		/* don't overwrite the slot before the consumer is done with it */
+		smp_mb();
+		r->cqes[cq_tail & (r->cq_entries - 1)] = cqe;
+		cq_tail++;
+
+		smp_wmb();
+		ACCESS_ONCE(hdr->sq_head) = sq_head;
+		ACCESS_ONCE(hdr->cq_tail) = cq_tail;
+		done++;
+
+		if (sq_head == sq_tail) {
+			sq_tail = ACCESS_ONCE(hdr->sq_tail);
+			smp_rmb();
+		}
+	}
+
+	if (done)
+		wake_up_interruptible(&r->cq_wait);
+
+	return done;
+}
+
+static int fwdt_ring_thread(void *data)
+{
+	struct fwdt_ring_ctx *r = data;
+	unsigned long idle_until = jiffies + r->idle;
+
+	while (!kthread_should_stop()) {
+		if (fwdt_ring_drain(r)) {
+			idle_until = jiffies + r->idle;
+			cond_resched();
+			continue;
+		}
+
+		if (r->sqpoll && time_before(jiffies, idle_until)) {
+			cond_resched();
+			continue;
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		ACCESS_ONCE(r->hdr->flags) = FWDT_RING_NEED_WAKEUP;
+		smp_mb();
+		/* an SQE queued before the flag was seen must not be lost */
+		if (!kthread_should_stop() && !fwdt_ring_has_work(r))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+		ACCESS_ONCE(r->hdr->flags) = 0;
+		idle_until = jiffies + r->idle;
+	}
+
+	return 0;
+}
+
+static void fwdt_ring_free(struct fwdt_ring_ctx *r)
+{
+	int i;
+
+	if (!r)
+		return;
+
+	if (r->thread)
+		kthread_stop(r->thread);
+	for (i = 0; i < r->num_methods; i++)
+		kfree(r->method_paths[i]);
+	vfree(r->hdr);
+	kfree(r);
+}
+
+static int fwdt_ring_mmap(struct fwdt_ring_ctx *r, struct vm_area_struct *vma)
+{
+	return remap_vmalloc_range(vma, r->hdr, vma->vm_pgoff);
+}
+
+static struct fwdt_ring_ctx *fwdt_ring_create(struct fwdt_ring *fr)
+{
+	struct fwdt_ring_ctx *r;
+	size_t sq_offset, cq_offset;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return NULL;
+
+	sq_offset = ALIGN(sizeof(struct fwdt_ring_header), 64);
+	cq_offset = sq_offset + fr->sq_entries * sizeof(struct fwdt_ring_sqe);
+	r->ring_bytes = PAGE_ALIGN(cq_offset +
+				   fr->cq_entries * sizeof(struct fwdt_ring_cqe));
+	r->sq_entries = fr->sq_entries;
+	r->cq_entries = fr->cq_entries;
+	r->sqpoll = fr->flags & FWDT_RING_SQPOLL;
+	r->idle = r->sqpoll ? msecs_to_jiffies(fr->idle_ms) : 0;
+	init_waitqueue_head(&r->cq_wait);
+
+	r->hdr = vmalloc_user(r->ring_bytes);
+	if (!r->hdr) {
+		fwdt_ring_free(r);
+		return NULL;
+	}
+	r->sqes = (void *) r->hdr + sq_offset;
+	r->cqes = (void *) r->hdr + cq_offset;
+	r->hdr->sq_entries = r->sq_entries;
+	r->hdr->cq_entries = r->cq_entries;
+	r->hdr->sq_offset = sq_offset;
+	r->hdr->cq_offset = cq_offset;
+
+	r->thread = kthread_run(fwdt_ring_thread, r, "fwdt_ring");
+	if (IS_ERR(r->thread)) {
+		r->thread = NULL;
+		fwdt_ring_free(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+static int handle_ring_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_ring fr;
+	struct fwdt_ring_ctx *r;
+	acpi_handle handle;
+	u32 want;
+	int ret = 0;
+
+	if (copy_from_user(&fr, fg, sizeof(fr)))
+		return -EFAULT;
+
+	mutex_lock(&ff->lock);
+	r = ff->ring;
+	switch (fr.parameters.func) {
+	case SETUP_RING:
+		/* like a sampler, a ring is set up once per open file */
+		if (ff->ring || ff->sampler || ff->watch || ff->acpi_events) {
+			ret = -EBUSY;
+			goto err;
+		}
+		if (!fr.cq_entries)
+			fr.cq_entries = min_t(u32, fr.sq_entries * 2,
+					      FWDT_RING_MAX_ENTRIES);
+		if (!is_power_of_2(fr.sq_entries) ||
+		    fr.sq_entries > FWDT_RING_MAX_ENTRIES ||
+		    !is_power_of_2(fr.cq_entries) ||
+		    fr.cq_entries > FWDT_RING_MAX_ENTRIES ||
+		    fr.idle_ms > FWDT_RING_MAX_IDLE_MS) {
+			ret = -EINVAL;
+			goto err;
+		}
+
+		r = fwdt_ring_create(&fr);
+		if (!r) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		smp_wmb();
+		ff->ring = r;
+		fr.ring_bytes = r->ring_bytes;
+		break;
+	case ENTER_RING:
+		if (!r) {
+			fr.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		mutex_unlock(&ff->lock);
+
+		wake_up_process(r->thread);
+		want = min(fr.min_complete, r->cq_entries);
+		if (want)
+			ret = wait_event_interruptible(r->cq_wait,
+					fwdt_ring_cq_ready(r) >= want);
+
+		mutex_lock(&ff->lock);
+		if (ret)
+			goto err;
+		break;
+	case REGISTER_RING_METHOD:
+		if (!r) {
+			fr.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		if (r->num_methods >= FWDT_RING_MAX_METHODS) {
+			ret = -ENOSPC;
+			goto err;
+		}
+
+		fr.path[sizeof(fr.path) - 1] = 0;
+		if (!ACPI_SUCCESS(fwdt_get_acpi_handle(fr.path, &handle))) {
+			fr.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		r->method_paths[r->num_methods] = kstrdup(fr.path, GFP_KERNEL);
+		if (!r->method_paths[r->num_methods]) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		r->methods[r->num_methods] = handle;
+		fr.method = r->num_methods;
+
+		/* the worker may use the entry as soon as it is counted */
+		smp_wmb();
+		ACCESS_ONCE(r->num_methods) = r->num_methods + 1;
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	fr.parameters.func_status = FWDT_SUCCESS;
+ out:
+	if (copy_to_user(fg, &fr, sizeof(fr)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+#define FWDT_WATCH_EVENTS	256
+
+/* events pending for one open file, oldest dropped when full */
+struct fwdt_watch_ctx {
+	spinlock_t		lock;
+	wait_queue_head_t	wait;
+	u32			head;
+	u32			tail;
+	u32			next_id;
+	int			count;
+	struct fwdt_watch_event	events[FWDT_WATCH_EVENTS];
+};
+
+struct fwdt_watchpoint {
+	struct list_head	list;
+	struct fwdt_watch_ctx	*ctx;
+	struct fwdt_watch	w;
+	unsigned long		interval;	/* jiffies */
+	unsigned long		due;
+	u64			last;
+	bool			primed;
+};
+
+/* every watch of every file is polled from this one work item */
+static LIST_HEAD(watch_list);
+static DEFINE_MUTEX(watch_lock);
+static void fwdt_watch_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(watch_work, fwdt_watch_work);
+
+static void fwdt_watch_post(struct fwdt_watch_ctx *ctx, u32 id, u64 old,
+			    u64 new)
+{
+	struct fwdt_watch_event *ev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->lock, flags);
+	if (ctx->head - ctx->tail == FWDT_WATCH_EVENTS)
+		ctx->tail++;
+	ev = &ctx->events[ctx->head++ % FWDT_WATCH_EVENTS];
+	ev->id = id;
+	ev->reserved = 0;
+	ev->old_value = old;
+	ev->new_value = new;
+	ev->timestamp = ktime_to_ns(ktime_get());
+	spin_unlock_irqrestore(&ctx->lock, flags);
+
+	wake_up_interruptible(&ctx->wait);
+}
+
+static void fwdt_watch_check(struct fwdt_watchpoint *wp)
+{
+	struct fwdt_batch_op op;
+	struct fwdt_batch_result res;
+	bool hit;
+	u64 cur;
+
+	op.func = wp->w.func;
+	op.target = wp->w.target;
+	op.device = wp->w.device;
+	op.address = wp->w.address;
+	op.data = 0;
+	if (fwdt_core_run_op(&fwdt_hw_backend, &op, &res))
+		return;
+
+	cur = res.data & wp->w.mask;
+	if (wp->w.mode == WATCH_EQUAL)
+		hit = cur == wp->w.value && wp->last != wp->w.value;
+	else
+		hit = cur != wp->last;
+
+	if (wp->primed && hit)
+		fwdt_watch_post(wp->ctx, wp->w.id, wp->last, cur);
+	wp->last = cur;
+	wp->primed = true;
+}
+
+static void fwdt_watch_work(struct work_struct *work)
+{
+	struct fwdt_watchpoint *wp;
+	unsigned long now = jiffies;
+	unsigned long next = now + MAX_JIFFY_OFFSET;
+
+	mutex_lock(&watch_lock);
+	list_for_each_entry(wp, &watch_list, list) {
+		if (time_after_eq(now, wp->due)) {
+			fwdt_watch_check(wp);
+			wp->due = now + wp->interval;
+		}
+		if (time_before(wp->due, next))
+			next = wp->due;
+	}
+	if (!list_empty(&watch_list))
+		schedule_delayed_work(&watch_work,
+				      time_after(next, jiffies) ?
+				      next - jiffies : 0);
+	mutex_unlock(&watch_lock);
+}
+
+/* drop the watches of one file, or all of them for id == 0 */
+static int fwdt_watch_del(struct fwdt_watch_ctx *ctx, u32 id)
+{
+	struct fwdt_watchpoint *wp, *tmp;
+	int found = 0;
+
+	mutex_lock(&watch_lock);
+	list_for_each_entry_safe(wp, tmp, &watch_list, list) {
+		if (wp->ctx != ctx || (id && wp->w.id != id))
+			continue;
+		list_del(&wp->list);
+		kfree(wp);
+		ctx->count--;
+		found++;
+	}
+	mutex_unlock(&watch_lock);
+
+	return found;
+}
+
+static void fwdt_watch_free(struct fwdt_watch_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	fwdt_watch_del(ctx, 0);
+	kfree(ctx);
+}
+
+static bool fwdt_watch_pending(struct fwdt_watch_ctx *ctx)
+{
+	return ACCESS_ONCE(ctx->head) != ACCESS_ONCE(ctx->tail);
+}
+
+static ssize_t fwdt_watch_read(struct fwdt_watch_ctx *ctx, char __user *buf,
+			       size_t count, bool nonblock)
+{
+	struct fwdt_watch_event ev;
+	size_t copied = 0;
+	unsigned long flags;
+	int ret;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	for (;;) {
+		while (count - copied >= sizeof(ev)) {
+			spin_lock_irqsave(&ctx->lock, flags);
+			if (ctx->head == ctx->tail) {
+				spin_unlock_irqrestore(&ctx->lock, flags);
+				break;
+			}
+			ev = ctx->events[ctx->tail++ % FWDT_WATCH_EVENTS];
+			spin_unlock_irqrestore(&ctx->lock, flags);
+
+			if (copy_to_user(buf + copied, &ev, sizeof(ev)))
+				return copied ? copied : -EFAULT;
+			copied += sizeof(ev);
+		}
+		if (copied)
+			return copied;
+
+		if (nonblock)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(ctx->wait,
+					       fwdt_watch_pending(ctx));
+		if (ret)
+			return ret;
+	}
+}
+
+static int handle_watch_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_watchpoint *wp;
+	struct fwdt_watch fw;
+	u16 func;
+	int ret = 0;
+
+	if (copy_from_user(&fw, fg, sizeof(fw)))
+		return -EFAULT;
+
+	mutex_lock(&ff->lock);
+	func = fw.parameters.func;
+	switch (func) {
+	case ADD_WATCH:
+		if (ff->sampler || ff->ring || ff->acpi_events || ff->session) {
+			ret = -EBUSY;
+			goto err;
+		}
+		if ((fw.func != GET_DATA_BYTE && fw.func != GET_DATA_WORD &&
+		     fw.func != GET_DATA_DWORD && fw.func != GET_DATA_QWORD) ||
+		    (fw.mode != WATCH_ANY_CHANGE && fw.mode != WATCH_EQUAL) ||
+		    fw.interval_ms < FWDT_WATCH_MIN_INTERVAL_MS) {
+			ret = -EINVAL;
+			goto err;
+		}
+
+		if (!ff->watch) {
+			ff->watch = kzalloc(sizeof(*ff->watch), GFP_KERNEL);
+			if (!ff->watch) {
+				ret = -ENOMEM;
+				goto err;
+			}
+			spin_lock_init(&ff->watch->lock);
+			init_waitqueue_head(&ff->watch->wait);
+		}
+		if (ff->watch->count >= FWDT_WATCH_MAX) {
+			ret = -ENOSPC;
+			goto err;
+		}
+
+		wp = kzalloc(sizeof(*wp), GFP_KERNEL);
+		if (!wp) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		fw.id = ++ff->watch->next_id;
+		wp->ctx = ff->watch;
+		wp->w = fw;
+		wp->interval = max_t(unsigned long, 1,
+				     msecs_to_jiffies(fw.interval_ms));
+		wp->due = jiffies;
+
+		mutex_lock(&watch_lock);
+		list_add_tail(&wp->list, &watch_list);
+		ff->watch->count++;
+		mutex_unlock(&watch_lock);
+		mod_delayed_work(system_wq, &watch_work, 0);
+		break;
+	case DEL_WATCH:
+	case CLEAR_WATCHES:
+		if (!ff->watch || !fwdt_watch_del(ff->watch,
+				func == DEL_WATCH ? fw.id : 0)) {
+			fw.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	fw.parameters.func_status = FWDT_SUCCESS;
+ out:
+	if (copy_to_user(fg, &fw, sizeof(fw)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+/* the capture has one reader, the file that started it */
+static struct fwdt_file *acpi_event_owner;
+static DEFINE_MUTEX(acpi_event_lock);
+static bool acpi_event_all_devices;
+static int acpi_event_num_devices;
+/* slots don't move, their path is the installed handler's context */
+static struct {
+	bool		used;
+	acpi_handle	handle;
+	char		path[64];
+} acpi_event_devices[FWDT_ACPI_EVENT_DEVICES];
+
+static bool fwdt_acpi_event_pending(void)
+{
+	struct fwdt_acpi_event_slot *slot;
+
+	slot = &acpi_event_ring[acpi_event_tail % FWDT_ACPI_EVENT_RING];
+	return ACCESS_ONCE(slot->seq) == acpi_event_tail + 1;
+}
+
+static ssize_t fwdt_acpi_event_read(char __user *buf, size_t count,
+				    bool nonblock)
+{
+	struct fwdt_acpi_event_slot *slot;
+	struct fwdt_acpi_event ev;
+	size_t copied = 0;
+	int ret;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	for (;;) {
+		mutex_lock(&acpi_event_lock);
+		while (count - copied >= sizeof(ev) &&
+		       fwdt_acpi_event_pending()) {
+			slot = &acpi_event_ring[acpi_event_tail %
+						FWDT_ACPI_EVENT_RING];
+			smp_rmb();
+			ev = slot->ev;
+			if (copy_to_user(buf + copied, &ev, sizeof(ev))) {
+				mutex_unlock(&acpi_event_lock);
+				return copied ? copied : -EFAULT;
+			}
+			copied += sizeof(ev);
+
+			/* the slot must be read before a producer reuses it */
+			smp_mb();
+			ACCESS_ONCE(acpi_event_tail) = acpi_event_tail + 1;
+		}
+		mutex_unlock(&acpi_event_lock);
+		if (copied)
+			return copied;
+
+		if (nonblock)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(acpi_event_wait,
+					       fwdt_acpi_event_pending());
+		if (ret)
+			return ret;
+	}
+}
+
+/* must be called with acpi_event_lock held */
+static void fwdt_acpi_event_stop(void)
+{
+	int i;
+
+	for (i = 0; i < FWDT_ACPI_EVENT_DEVICES; i++) {
+		if (!acpi_event_devices[i].used)
+			continue;
+		acpi_remove_notify_handler(acpi_event_devices[i].handle,
+					   ACPI_ALL_NOTIFY,
+					   fwdt_acpi_event_notify);
+		acpi_event_devices[i].used = false;
+	}
+	acpi_event_num_devices = 0;
+
+	if (acpi_event_all_devices)
+		acpi_remove_notify_handler(ACPI_ROOT_OBJECT,
+					   ACPI_DEVICE_NOTIFY,
+					   fwdt_acpi_event_notify);
+	acpi_event_all_devices = false;
+
+	ACCESS_ONCE(acpi_events_enabled) = false;
+	acpi_event_owner->acpi_events = false;
+	acpi_event_owner = NULL;
+}
+
+static void fwdt_acpi_event_release(struct fwdt_file *ff)
+{
+	mutex_lock(&acpi_event_lock);
+	if (acpi_event_owner == ff)
+		fwdt_acpi_event_stop();
+	mutex_unlock(&acpi_event_lock);
+}
+
+static int fwdt_acpi_event_start(struct fwdt_file *ff, u32 flags)
+{
+	unsigned long long gpe;
+
+	if (acpi_event_owner)
+		return -EBUSY;
+
+	if (flags & FWDT_ACPI_EVENT_ALL_DEVICES) {
+		if (!ACPI_SUCCESS(acpi_install_notify_handler(ACPI_ROOT_OBJECT,
+				ACPI_DEVICE_NOTIFY, fwdt_acpi_event_notify,
+				NULL)))
+			return -EBUSY;
+		acpi_event_all_devices = true;
+	}
+
+	acpi_event_ec_gpe = FWDT_ACPI_EVENT_NO_EC_GPE;
+	if (ec_device && ACPI_SUCCESS(fwdt_acpi_evaluate_integer(ec_device,
+					NULL, "_GPE", NULL, &gpe)))
+		acpi_event_ec_gpe = gpe;
+
+	/* start empty; no producer runs while acpi_events_enabled is off */
+	atomic_set(&acpi_event_head, 0);
+	acpi_event_tail = 0;
+	memset(acpi_event_ring, 0, sizeof(acpi_event_ring));
+	atomic_long_set(&acpi_events_dropped, 0);
+	smp_wmb();
+	ACCESS_ONCE(acpi_events_enabled) = true;
+	acpi_event_owner = ff;
+	ff->acpi_events = true;
+
+	return 0;
+}
+
+static int handle_acpi_event_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_acpi_events fae;
+	acpi_handle handle;
+	int i, ret = 0;
+
+	if (copy_from_user(&fae, fg, sizeof(fae)))
+		return -EFAULT;
+	fae.path[sizeof(fae.path) - 1] = 0;
+
+	mutex_lock(&ff->lock);
+	mutex_lock(&acpi_event_lock);
+	if (fae.parameters.func != START_ACPI_EVENTS &&
+	    acpi_event_owner != ff) {
+		fae.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		goto out;
+	}
+
+	switch (fae.parameters.func) {
+	case START_ACPI_EVENTS:
+		if (ff->sampler || ff->ring || ff->watch || ff->acpi_events ||
+		    ff->session) {
+			ret = -EBUSY;
+			goto err;
+		}
+		ret = fwdt_acpi_event_start(ff, fae.flags);
+		if (ret)
+			goto err;
+		break;
+	case STOP_ACPI_EVENTS:
+		/* events already captured can't be read any more */
+		fwdt_acpi_event_stop();
+		break;
+	case ADD_ACPI_EVENT_DEVICE:
+		if (acpi_event_num_devices >= FWDT_ACPI_EVENT_DEVICES) {
+			ret = -ENOSPC;
+			goto err;
+		}
+		if (!ACPI_SUCCESS(fwdt_get_acpi_handle(fae.path, &handle))) {
+			fae.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+
+		for (i = 0; acpi_event_devices[i].used; i++)
+			;
+		acpi_event_devices[i].handle = handle;
+		strlcpy(acpi_event_devices[i].path, fae.path,
+			sizeof(acpi_event_devices[i].path));
+		if (!ACPI_SUCCESS(acpi_install_notify_handler(handle,
+				ACPI_ALL_NOTIFY, fwdt_acpi_event_notify,
+				acpi_event_devices[i].path))) {
+			fae.parameters.func_status = FWDT_FAIL;
+			goto out;
+		}
+		acpi_event_devices[i].used = true;
+		acpi_event_num_devices++;
+		break;
+	case DEL_ACPI_EVENT_DEVICE:
+		for (i = 0; i < FWDT_ACPI_EVENT_DEVICES; i++)
+			if (acpi_event_devices[i].used &&
+			    !strcmp(acpi_event_devices[i].path, fae.path))
+				break;
+		if (i == FWDT_ACPI_EVENT_DEVICES) {
+			fae.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+
+		acpi_remove_notify_handler(acpi_event_devices[i].handle,
+					   ACPI_ALL_NOTIFY,
+					   fwdt_acpi_event_notify);
+		acpi_event_devices[i].used = false;
+		acpi_event_num_devices--;
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	fae.parameters.func_status = FWDT_SUCCESS;
+ out:
+	fae.dropped = atomic_long_read(&acpi_events_dropped);
+	if (copy_to_user(fg, &fae, sizeof(fae)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&acpi_event_lock);
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+static void fwdt_acpi_free_object(union acpi_object *obj)
+{
+	u32 i;
+
+	if (obj->type != ACPI_TYPE_PACKAGE)
+		return;
+
+	for (i = 0; i < obj->package.count; i++)
+		fwdt_acpi_free_object(&obj->package.elements[i]);
+	kfree(obj->package.elements);
+}
+
+/* strings and buffers point into blob, which must outlive obj */
+static int fwdt_acpi_parse_object(u8 *blob, u32 size, u32 *pos,
+				  union acpi_object *obj, int depth)
+{
+	struct fwdt_acpi_object_hdr hdr;
+	u32 i;
+	int err;
+
+	if (depth > FWDT_ACPI_EVAL_MAX_DEPTH || size - *pos < sizeof(hdr))
+		return -EINVAL;
+	memcpy(&hdr, blob + *pos, sizeof(hdr));
+	*pos += sizeof(hdr);
+
+	switch (hdr.type) {
+	case FWDT_ACPI_INTEGER:
+		if (hdr.length != sizeof(u64) || size - *pos < sizeof(u64))
+			return -EINVAL;
+		obj->type = ACPI_TYPE_INTEGER;
+		memcpy(&obj->integer.value, blob + *pos, sizeof(u64));
+		*pos += sizeof(u64);
+		break;
+	case FWDT_ACPI_STRING:
+		if (size - *pos < hdr.length)
+			return -EINVAL;
+		obj->type = ACPI_TYPE_STRING;
+		obj->string.length = hdr.length;
+		obj->string.pointer = (char *) blob + *pos;
+		*pos += hdr.length;
+		break;
+	case FWDT_ACPI_BUFFER:
+		if (size - *pos < hdr.length)
+			return -EINVAL;
+		obj->type = ACPI_TYPE_BUFFER;
+		obj->buffer.length = hdr.length;
+		obj->buffer.pointer = blob + *pos;
+		*pos += hdr.length;
+		break;
+	case FWDT_ACPI_PACKAGE:
+		/* every element needs at least a header */
+		if (hdr.length > (size - *pos) / sizeof(hdr))
+			return -EINVAL;
+		obj->type = ACPI_TYPE_PACKAGE;
+		obj->package.count = 0;
+		obj->package.elements = kcalloc(hdr.length, sizeof(*obj),
+						GFP_KERNEL);
+		if (hdr.length && !obj->package.elements)
+			return -ENOMEM;
+		for (i = 0; i < hdr.length; i++) {
+			obj->package.count = i + 1;
+			err = fwdt_acpi_parse_object(blob, size, pos,
+					&obj->package.elements[i], depth + 1);
+			if (err)
+				return err;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+struct fwdt_acpi_writer {
+	u8	*buf;
+	size_t	size;
+	size_t	pos;		/* may run past size to report the need */
+};
+
+static void fwdt_acpi_put(struct fwdt_acpi_writer *w, const void *data,
+			  size_t len)
+{
+	if (w->pos + len <= w->size)
+		memcpy(w->buf + w->pos, data, len);
+	w->pos += len;
+}
+
+static void fwdt_acpi_encode_object(struct fwdt_acpi_writer *w,
+				    union acpi_object *obj)
+{
+	struct acpi_buffer name = { ACPI_ALLOCATE_BUFFER, NULL };
+	struct fwdt_acpi_object_hdr hdr = { obj->type, 0, 0 };
+	u32 i;
+
+	switch (obj->type) {
+	case ACPI_TYPE_INTEGER:
+		hdr.length = sizeof(u64);
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		fwdt_acpi_put(w, &obj->integer.value, sizeof(u64));
+		break;
+	case ACPI_TYPE_STRING:
+		hdr.length = obj->string.length;
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		fwdt_acpi_put(w, obj->string.pointer, hdr.length);
+		break;
+	case ACPI_TYPE_BUFFER:
+		hdr.length = obj->buffer.length;
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		fwdt_acpi_put(w, obj->buffer.pointer, hdr.length);
+		break;
+	case ACPI_TYPE_PACKAGE:
+		hdr.length = obj->package.count;
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		for (i = 0; i < obj->package.count; i++)
+			fwdt_acpi_encode_object(w, &obj->package.elements[i]);
+		break;
+	case ACPI_TYPE_LOCAL_REFERENCE:
+		if (ACPI_SUCCESS(acpi_get_name(obj->reference.handle,
+					       ACPI_FULL_PATHNAME, &name)))
+			hdr.length = strlen(name.pointer);
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		fwdt_acpi_put(w, name.pointer, hdr.length);
+		kfree(name.pointer);
+		break;
+	default:
+		fwdt_acpi_put(w, &hdr, sizeof(hdr));
+		break;
+	}
+}
+
+static int handle_acpi_eval_cmd(fwdt_generic __user *fg)
+{
+	struct acpi_buffer buffer = { ACPI_ALLOCATE_BUFFER, NULL };
+	struct fwdt_acpi_writer w = { NULL, 0, 0 };
+	struct acpi_object_list args = { 0, NULL };
+	struct fwdt_acpi_eval *fae;
+	acpi_handle handle;
+	acpi_status status;
+	u8 *blob = NULL;
+	u32 pos = 0, i;
+	int ret = 0;
+
+	fae = kmalloc(sizeof(*fae), GFP_KERNEL);
+	if (!fae)
+		return -ENOMEM;
+
+	if (copy_from_user(fae, fg, sizeof(*fae))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (fae->parameters.func != EVALUATE_ACPI_METHOD) {
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto out;
+	}
+
+	if (fae->num_args > FWDT_ACPI_EVAL_MAX_ARGS ||
+	    fae->args_size > FWDT_ACPI_EVAL_MAX_SIZE ||
+	    fae->result_size > FWDT_ACPI_EVAL_MAX_SIZE) {
+		ret = -EINVAL;
+		goto out;
+	}
+	fae->path[sizeof(fae->path) - 1] = 0;
+
+	blob = kmalloc(fae->args_size, GFP_KERNEL);
+	args.pointer = kcalloc(fae->num_args, sizeof(union acpi_object),
+			       GFP_KERNEL);
+	w.buf = kmalloc(fae->result_size, GFP_KERNEL);
+	if ((fae->args_size && !blob) || (fae->num_args && !args.pointer) ||
+	    (fae->result_size && !w.buf)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	w.size = fae->result_size;
+
+	if (copy_from_user(blob, (void __user *) (unsigned long) fae->args,
+			   fae->args_size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < fae->num_args; i++) {
+		args.count = i + 1;
+		ret = fwdt_acpi_parse_object(blob, fae->args_size, &pos,
+					     &args.pointer[i], 0);
+		if (ret)
+			goto out;
+	}
+
+	status = fwdt_get_acpi_handle(fae->path, &handle);
+	if (!ACPI_SUCCESS(status)) {
+		fae->acpi_status = status;
+		fae->result_size = 0;
+		fae->parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+		goto copy;
+	}
+
+	status = fwdt_acpi_evaluate(handle, fae->path, NULL,
+				    args.count ? &args : NULL, &buffer);
+	fae->acpi_status = status;
+	if (buffer.pointer)
+		fwdt_acpi_encode_object(&w, buffer.pointer);
+
+	/* too small a buffer fails with result_size set to what it needs */
+	fae->result_size = w.pos;
+	if (!ACPI_SUCCESS(status) || w.pos > w.size)
+		fae->parameters.func_status = FWDT_FAIL;
+	else if (copy_to_user((void __user *) (unsigned long) fae->result,
+			      w.buf, w.pos))
+		ret = -EFAULT;
+	else
+		fae->parameters.func_status = FWDT_SUCCESS;
+
+ copy:
+	if (!ret && copy_to_user(fg, fae, sizeof(*fae)))
+		ret = -EFAULT;
+ out:
+	for (i = 0; i < args.count; i++)
+		fwdt_acpi_free_object(&args.pointer[i]);
+	kfree(buffer.pointer);
+	kfree(args.pointer);
+	kfree(w.buf);
+	kfree(blob);
+	kfree(fae);
+	return ret;
+}
+
+/* copy whole samples out of the rings, visiting them round robin */
+static ssize_t fwdt_sampler_drain(struct fwdt_sampler *s, char __user *buf,
+				  size_t count)
+{
+	struct fwdt_sampler_cpu *sc;
+	struct fwdt_sample_ring *ring;
+	size_t copied = 0;
+	u32 head, tail;
+	int i, r;
+
+	for (i = 0; i < s->num_rings; i++) {
+		r = (s->next_ring + i) % s->num_rings;
+		sc = &s->cpus[r];
+		ring = sc->ring;
+		head = ACCESS_ONCE(sc->head);
+		smp_rmb();
+
+		/* a mapped consumer may have scribbled over tail */
+		tail = ACCESS_ONCE(ring->tail);
+		if (head - tail > sc->size)
+			tail = head - sc->size;
+
+		for (; tail != head; tail++) {
+			if (count - copied < sizeof(struct fwdt_msr_sample))
+				break;
+			if (copy_to_user(buf + copied,
+					 &ring->samples[tail & (sc->size - 1)],
+					 sizeof(struct fwdt_msr_sample))) {
+				ring->tail = tail;
+				return copied ? copied : -EFAULT;
+			}
+			copied += sizeof(struct fwdt_msr_sample);
+		}
+
+		/* the slots must be read before the producer may reuse them */
+		smp_mb();
+		ACCESS_ONCE(ring->tail) = tail;
+	}
+	s->next_ring = (s->next_ring + 1) % s->num_rings;
+
+	return copied;
+}
+
+/*
+ * The target a file selected with FWDT_SESSION_CMD, so each client keeps
+ * its own address instead of sharing the sysfs address attributes.
+ * Protected by the file's lock; memory keeps one page mapped per session
+ * rather than going through the shared iomap cache and its lock.
+ */
+struct fwdt_session_ctx {
+	u16			target;
+	u8			width;
+	u32			device;
+	u64			mem_page;
+	void __iomem		*mem_virt;
+};
+
+static void fwdt_session_free(struct fwdt_session_ctx *ss)
+{
+	if (!ss)
+		return;
+
+	if (ss->mem_virt)
+		iounmap(ss->mem_virt);
+	kfree(ss);
+}
+
+/* must be called with ff->lock held */
+static void __iomem *fwdt_session_iomap(struct fwdt_session_ctx *ss,
+					u64 address)
+{
+	u64 page = address & PAGE_MASK;
+
+	if (!ss->mem_virt || ss->mem_page != page) {
+		if (ss->mem_virt)
+			iounmap(ss->mem_virt);
+		ss->mem_virt = ioremap(page, PAGE_SIZE);
+		ss->mem_page = page;
+		if (!ss->mem_virt)
+			return NULL;
+	}
+
+	return ss->mem_virt + (address - page);
+}
+
+static u16 fwdt_session_func(u8 width, bool write)
+{
+	u16 func;
+
+	switch (width) {
+	case 1:
+		func = GET_DATA_BYTE;
+		break;
+	case 2:
+		func = GET_DATA_WORD;
+		break;
+	case 4:
+		func = GET_DATA_DWORD;
+		break;
+	default:
+		func = GET_DATA_QWORD;
+		break;
+	}
+
+	/* each SET_DATA_* follows its GET_DATA_* */
+	return write ? func + 1 : func;
+}
+
+/* one width-sized access at a time; must be called with ff->lock held */
+static int fwdt_session_access(struct fwdt_file *ff, bool write, u64 pos,
+			       u8 *buf, size_t len)
+{
+	struct fwdt_session_ctx *ss = ff->session;
+	u16 func = fwdt_session_func(ss->width, write);
+	void __iomem *mem;
+	cycles_t start;
+	u64 data;
+	size_t i;
+	int ret = 0;
+
+	start = get_cycles();
+	for (i = 0; i < len && !ret; i += ss->width) {
+		data = 0;
+		if (write)
+			memcpy(&data, buf + i, ss->width);
+
+		switch (ss->target) {
+		case FWDT_TARGET_IO:
+			ret = fwdt_io_access(func, pos + i, &data);
+			break;
+		case FWDT_TARGET_MEMORY:
+			mem = fwdt_session_iomap(ss, pos + i);
+			if (!mem) {
+				ret = FWDT_FAIL;
+				break;
+			}
+			if (ss->width == 1 && write)
+				writeb(data, mem);
+			else if (ss->width == 1)
+				data = readb(mem);
+			else if (ss->width == 2 && write)
+				writew(data, mem);
+			else if (ss->width == 2)
+				data = readw(mem);
+			else if (write)
+				writel(data, mem);
+			else
+				data = readl(mem);
+			break;
+		case FWDT_TARGET_MSR:
+			ret = fwdt_msr_access(func, ss->device, pos + i / 8,
+					      &data);
+			break;
+		}
+
+		if (!write)
+			memcpy(buf + i, &data, ss->width);
+	}
+
+	if (ss->target == FWDT_TARGET_MEMORY)
+		trace_fwdt_mem_range(func, 0, pos, len, ret,
+				     get_cycles() - start);
+
+	return ret ? -EIO : 0;
+}
+
+/* must be called with ff->lock held */
+static int fwdt_session_range(struct fwdt_file *ff, bool write, u64 pos,
+			      u8 *buf, size_t len)
+{
+	struct fwdt_session_ctx *ss = ff->session;
+	struct pci_dev *pdev;
+
+	switch (ss->target) {
+	case FWDT_TARGET_CMOS:
+		return fwdt_cmos_range(write ? WRITE_CMOS_RANGE :
+				       READ_CMOS_RANGE, pos, buf, len);
+	case FWDT_TARGET_EC:
+		if (fwdt_ec_range(write ? WRITE_EC_RANGE : READ_EC_RANGE, pos,
+				  buf, len))
+			return -EIO;
+		return 0;
+	case FWDT_TARGET_PCI:
+		pdev = fwdt_file_pci_dev(ff, ss->device);
+		if (!pdev)
+			return -ENODEV;
+		if (fwdt_pci_config_range(pdev, write ? WRITE_PCI_CONFIG :
+					  READ_PCI_CONFIG, pos, buf, len))
+			return -EIO;
+		return 0;
+	}
+
+	return fwdt_session_access(ff, write, pos, buf, len);
+}
+
+/* must be called with ff->lock held */
+static u64 fwdt_session_size(struct fwdt_file *ff)
+{
+	struct fwdt_session_ctx *ss = ff->session;
+	struct pci_dev *pdev;
+
+	switch (ss->target) {
+	case FWDT_TARGET_IO:
+		return 0x10000;
+	case FWDT_TARGET_CMOS:
+		return FWDT_CMOS_SIZE;
+	case FWDT_TARGET_EC:
+		return FWDT_EC_SIZE;
+	case FWDT_TARGET_PCI:
+		pdev = fwdt_file_pci_dev(ff, ss->device);
+		return pdev ? pdev->cfg_size : 0;
+	case FWDT_TARGET_MSR:
+		return 1ULL << 32;
+	}
+
+	return ULLONG_MAX;
+}
+
+static ssize_t fwdt_session_rw(struct fwdt_file *ff, bool write,
+			       char __user *buf, size_t count, loff_t *ppos)
+{
+	struct fwdt_session_ctx *ss;
+	u64 pos = *ppos, size;
+	size_t done = 0, n;
+	u8 *bounce;
+	int regs, ret = 0;
+
+	bounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!bounce)
+		return -ENOMEM;
+
+	mutex_lock(&ff->lock);
+	ss = ff->session;
+	if (!ss) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* MSR positions count registers, everything else bytes */
+	regs = ss->target == FWDT_TARGET_MSR ? 8 : 1;
+	if (count % ss->width || (regs == 1 && pos % ss->width)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	size = fwdt_session_size(ff);
+	if (pos >= size)
+		goto out;
+	if (count / regs > size - pos)
+		count = (size - pos) * regs;
+
+	for (done = 0; done < count; done += n) {
+		n = min_t(size_t, count - done, PAGE_SIZE);
+		if (write && copy_from_user(bounce, buf + done, n)) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = fwdt_session_range(ff, write, pos + done / regs,
+					 bounce, n);
+		if (ret)
+			break;
+		if (!write && copy_to_user(buf + done, bounce, n)) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+	*ppos = pos + done / regs;
+ out:
+	mutex_unlock(&ff->lock);
+	kfree(bounce);
+	return done ? done : ret;
+}
+
+static int handle_session_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_session fs;
+	struct fwdt_session_ctx *ss;
+	int ret = 0;
+
+	if (copy_from_user(&fs, fg, sizeof(fs)))
+		return -EFAULT;
+
+	mutex_lock(&ff->lock);
+	switch (fs.parameters.func) {
+	case SELECT_SESSION_TARGET:
+		/* read() belongs to whichever of these the file set up */
+		if (ff->sampler || ff->watch || ff->acpi_events) {
+			ret = -EBUSY;
+			goto err;
+		}
+
+		switch (fs.target) {
+		case FWDT_TARGET_IO:
+		case FWDT_TARGET_MEMORY:
+			if (fs.width != 1 && fs.width != 2 && fs.width != 4) {
+				ret = -EINVAL;
+				goto err;
+			}
+			break;
+		case FWDT_TARGET_MSR:
+			fs.width = 8;
+			break;
+		case FWDT_TARGET_CMOS:
+		case FWDT_TARGET_PCI:
+		case FWDT_TARGET_EC:
+			fs.width = 1;
+			break;
+		default:
+			fs.parameters.func_status = FWDT_FUNC_NOT_SUPPORTED;
+			goto out;
+		}
+
+		if ((fs.target == FWDT_TARGET_EC && !ec_device) ||
+		    (fs.target == FWDT_TARGET_PCI &&
+		     !fwdt_file_pci_dev(ff, fs.device)) ||
+		    (fs.target == FWDT_TARGET_MSR && !cpu_online(fs.device))) {
+			fs.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+
+		ss = kzalloc(sizeof(*ss), GFP_KERNEL);
+		if (!ss) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		ss->target = fs.target;
+		ss->width = fs.width;
+		ss->device = fs.device;
+
+		fwdt_session_free(ff->session);
+		ff->session = ss;
+		break;
+	case CLEAR_SESSION_TARGET:
+		fwdt_session_free(ff->session);
+		ff->session = NULL;
+		break;
+	default:
+		fs.parameters.func_status = FWDT_FUNC_NOT_SUPPORTED;
+		goto out;
+	}
+
+	fs.parameters.func_status = FWDT_SUCCESS;
+ out:
+	if (copy_to_user(fg, &fs, sizeof(fs)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+static ssize_t fwdt_runtime_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	return fwdt_session_rw(file->private_data, true, (char __user *) buf,
+			       count, ppos);
+}
+
+/* only a session has a position, bounded by its target */
+static loff_t fwdt_runtime_llseek(struct file *file, loff_t offset, int orig)
+{
+	struct fwdt_file *ff = file->private_data;
+	u64 size;
+
+	mutex_lock(&ff->lock);
+	if (!ff->session) {
+		offset = -ESPIPE;
+		goto out;
+	}
+
+	size = min_t(u64, fwdt_session_size(ff), LLONG_MAX);
+	switch (orig) {
+	case SEEK_CUR:
+		offset += file->f_pos;
+		break;
+	case SEEK_END:
+		offset += size;
+		break;
+	case SEEK_SET:
+		break;
+	default:
+		offset = -EINVAL;
+		goto out;
+	}
+
+	if (offset < 0 || offset > size) {
+		offset = -EINVAL;
+		goto out;
+	}
+	file->f_pos = offset;
+ out:
+	mutex_unlock(&ff->lock);
+	return offset;
+}
+
+static ssize_t fwdt_runtime_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_sampler *s = ACCESS_ONCE(ff->sampler);
+	struct fwdt_watch_ctx *ctx = ACCESS_ONCE(ff->watch);
+	bool stopped;
+	ssize_t ret;
+
+	if (ACCESS_ONCE(ff->session))
+		return fwdt_session_rw(ff, false, buf, count, ppos);
+	if (ctx)
+		return fwdt_watch_read(ctx, buf, count,
+				       file->f_flags & O_NONBLOCK);
+	if (ACCESS_ONCE(acpi_event_owner) == ff)
+		return fwdt_acpi_event_read(buf, count,
+					    file->f_flags & O_NONBLOCK);
+
+	if (!s || count < sizeof(struct fwdt_msr_sample))
+		return -EINVAL;
+	smp_rmb();
+
+	for (;;) {
+		stopped = !ACCESS_ONCE(s->running);
+		smp_rmb();
+
+		mutex_lock(&s->read_lock);
+		ret = fwdt_sampler_drain(s, buf, count);
+		mutex_unlock(&s->read_lock);
+		if (ret)
+			return ret;
+
+		/* a stopped sampler reads as EOF once its rings are empty */
+		if (stopped)
+			return 0;
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(s->wait,
+					       fwdt_sampler_pending(s) ||
+					       !ACCESS_ONCE(s->running));
+		if (ret)
+			return ret;
+	}
+}
+
+static unsigned int fwdt_runtime_poll(struct file *file, poll_table *wait)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_sampler *s = ACCESS_ONCE(ff->sampler);
+	struct fwdt_ring_ctx *r = ACCESS_ONCE(ff->ring);
+	struct fwdt_watch_ctx *ctx = ACCESS_ONCE(ff->watch);
+
+	if (ctx) {
+		poll_wait(file, &ctx->wait, wait);
+		return fwdt_watch_pending(ctx) ? POLLIN | POLLRDNORM : 0;
+	}
+
+	if (ACCESS_ONCE(acpi_event_owner) == ff) {
+		poll_wait(file, &acpi_event_wait, wait);
+		return fwdt_acpi_event_pending() ? POLLIN | POLLRDNORM : 0;
+	}
+
+	/* a ring is readable while it holds completions */
+	if (r) {
+		smp_rmb();
+		poll_wait(file, &r->cq_wait, wait);
+		return fwdt_ring_cq_ready(r) ? POLLIN | POLLRDNORM : 0;
+	}
+
+	if (!s)
+		return POLLERR;
+	smp_rmb();
+
+	poll_wait(file, &s->wait, wait);
+
+	if (fwdt_sampler_pending(s))
+		return POLLIN | POLLRDNORM;
+
+	return ACCESS_ONCE(s->running) ? 0 : POLLHUP;
+}
+
+static int handle_pci_config_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_pci_config fpc;
+	struct pci_dev *pdev;
+	void __user *ubuf;
+	u8 *buf;
+	u16 func;
+	int ret = 0;
+
+	if (copy_from_user(&fpc, fg, sizeof(fpc)))
+		return -EFAULT;
+
+	func = fpc.parameters.func;
+	if (func != READ_PCI_CONFIG && func != WRITE_PCI_CONFIG)
+		return FWDT_FUNC_NOT_SUPPORTED;
+
+	if (!fpc.length || fpc.offset + fpc.length > FWDT_PCI_CONFIG_SIZE)
+		return -EINVAL;
+
+	ubuf = (void __user *) (unsigned long) fpc.buffer;
+	buf = kmalloc(fpc.length, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if (func == WRITE_PCI_CONFIG &&
+	    copy_from_user(buf, ubuf, fpc.length)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	mutex_lock(&ff->lock);
+	pdev = fwdt_file_pci_dev(ff, fpc.device);
+	if (!pdev)
+		fpc.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+	else if (fpc.offset + fpc.length > pdev->cfg_size)
+		fpc.parameters.func_status = FWDT_FAIL;
+	else
+		fpc.parameters.func_status = fwdt_pci_config_range(pdev, func,
+						fpc.offset, buf, fpc.length);
+	mutex_unlock(&ff->lock);
+
+	if (func == READ_PCI_CONFIG &&
+	    fpc.parameters.func_status == FWDT_SUCCESS &&
+	    copy_to_user(ubuf, buf, fpc.length)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (copy_to_user(fg, &fpc, sizeof(fpc)))
+		ret = -EFAULT;
+ out:
+	kfree(buf);
+	return ret;
+}
+
+#define FWDT_PCI_SNAPSHOT_HASH_BITS	7
+
+/* hash of each function's config space as of the previous diff */
+struct fwdt_pci_snapshot_entry {
+	struct hlist_node	node;
+	u32			device;
+	u32			hash;
+};
+
+static DEFINE_HASHTABLE(pci_snapshot_hash, FWDT_PCI_SNAPSHOT_HASH_BITS);
+static DEFINE_MUTEX(pci_snapshot_lock);
+
+struct fwdt_pci_snapshot_iter {
+	bool	diff;
+	bool	last_valid;
+	u32	last_device;
+	bool	last_changed;
+	u8	config[FWDT_PCI_CONFIG_SIZE];
+};
+
+/* record the new hash of a function and report whether it changed */
+static bool fwdt_pci_snapshot_update(u32 device, u32 hash)
+{
+	struct fwdt_pci_snapshot_entry *entry;
+	bool changed = true;
+
+	mutex_lock(&pci_snapshot_lock);
+	hash_for_each_possible(pci_snapshot_hash, entry, node, device) {
+		if (entry->device != device)
+			continue;
+		changed = entry->hash != hash;
+		entry->hash = hash;
+		goto out;
+	}
+
+	entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+	if (entry) {
+		entry->device = device;
+		entry->hash = hash;
+		hash_add(pci_snapshot_hash, &entry->node, device);
+	}
+ out:
+	mutex_unlock(&pci_snapshot_lock);
+	return changed;
+}
+
+static void fwdt_pci_snapshot_cleanup(void)
+{
+	struct fwdt_pci_snapshot_entry *entry;
+	struct hlist_node *tmp;
+	int bkt;
+
+	mutex_lock(&pci_snapshot_lock);
+	hash_for_each_safe(pci_snapshot_hash, bkt, tmp, entry, node) {
+		hash_del(&entry->node);
+		kfree(entry);
+	}
+	mutex_unlock(&pci_snapshot_lock);
+}
+
+static void *pci_snapshot_start(struct seq_file *m, loff_t *pos)
+{
+	struct pci_dev *pdev = NULL;
+	loff_t n = *pos;
+
+	for_each_pci_dev(pdev)
+		if (n-- == 0)
+			return pdev;
+
+	return NULL;
+}
+
+static void *pci_snapshot_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+
+	return pci_get_device(PCI_ANY_ID, PCI_ANY_ID, v);
+}
+
+static void pci_snapshot_stop(struct seq_file *m, void *v)
+{
+	if (v)
+		pci_dev_put(v);
+}
+
+static int pci_snapshot_show(struct seq_file *m, void *v)
+{
+	struct fwdt_pci_snapshot_iter *iter = m->private;
+	struct pci_dev *pdev = v;
+	struct fwdt_pci_record rec;
+	bool changed;
+
+	rec.device = FWDT_PCI_DEVICE(pci_domain_nr(pdev->bus),
+				     pdev->bus->number, PCI_SLOT(pdev->devfn),
+				     PCI_FUNC(pdev->devfn));
+	rec.size = pdev->cfg_size;
+	rec.reserved = 0;
+
+	if (fwdt_pci_config_range(pdev, READ_PCI_CONFIG, 0, iter->config,
+				  rec.size))
+		return 0;
+
+	/* the baseline belongs to pci_snapshot_diff alone */
+	if (!iter->diff)
+		goto out;
+
+	/* seq_file calls show again for a record that overflowed its buffer */
+	if (iter->last_valid && iter->last_device == rec.device) {
+		changed = iter->last_changed;
+	} else {
+		changed = fwdt_pci_snapshot_update(rec.device,
+					jhash(iter->config, rec.size, 0));
+		iter->last_valid = true;
+		iter->last_device = rec.device;
+		iter->last_changed = changed;
+	}
+
+	if (!changed)
+		return 0;
+ out:
+	seq_write(m, &rec, sizeof(rec));
+	seq_write(m, iter->config, rec.size);
+
+	return 0;
+}
+
+static const struct seq_operations pci_snapshot_seq_ops = {
+	.start	= pci_snapshot_start,
+	.next	= pci_snapshot_next,
+	.stop	= pci_snapshot_stop,
+	.show	= pci_snapshot_show,
+};
+
+static int pci_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct fwdt_pci_snapshot_iter *iter;
+
+	iter = __seq_open_private(file, &pci_snapshot_seq_ops, sizeof(*iter));
+	if (!iter)
+		return -ENOMEM;
+
+	iter->diff = inode->i_private != NULL;
+
+	return 0;
+}
+
+static const struct file_operations pci_snapshot_fops = {
+	.owner		= THIS_MODULE,
+	.open		= pci_snapshot_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release_private,
+};
+
+/* per-block hashes of one range, as of the last time each was returned */
+struct fwdt_scan_range {
+	struct list_head	list;
+	u32			id;
+	u32			block_size;
+	u64			address;
+	u64			size;
+	void __iomem		*virt;
+	u32			*hashes;
+};
+
+/* the ranges of one open file, protected by its lock */
+struct fwdt_scan_ctx {
+	struct list_head	ranges;
+	u32			next_id;
+	int			count;
+};
+
+static void fwdt_scan_range_free(struct fwdt_scan_range *sr)
+{
+	iounmap(sr->virt);
+	vfree(sr->hashes);
+	kfree(sr);
+}
+
+/* drop the ranges of one file, or all of them for id == 0 */
+static int fwdt_scan_del(struct fwdt_scan_ctx *ctx, u32 id)
+{
+	struct fwdt_scan_range *sr, *tmp;
+	int found = 0;
+
+	list_for_each_entry_safe(sr, tmp, &ctx->ranges, list) {
+		if (id && sr->id != id)
+			continue;
+		list_del(&sr->list);
+		fwdt_scan_range_free(sr);
+		ctx->count--;
+		found++;
+	}
+
+	return found;
+}
+
+static void fwdt_scan_free(struct fwdt_scan_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	fwdt_scan_del(ctx, 0);
+	kfree(ctx);
+}
+
+/* blocks are a multiple of 64 bytes, so hash them a word at a time */
+static u32 fwdt_scan_hash(const u8 *block, u32 size)
+{
+	return jhash2((const u32 *) block, size / sizeof(u32), 0);
+}
+
+static int fwdt_scan_add(struct fwdt_scan_ctx *ctx, struct fwdt_mem_scan *fs)
+{
+	struct fwdt_scan_range *sr;
+	u64 i, blocks;
+	u8 *bounce;
+	int ret = -ENOMEM;
+
+	if (!is_power_of_2(fs->block_size) ||
+	    fs->block_size < FWDT_SCAN_MIN_BLOCK ||
+	    fs->block_size > PAGE_SIZE || !fs->size ||
+	    fs->size > FWDT_SCAN_MAX_SIZE || fs->size % fs->block_size)
+		return -EINVAL;
+	if (ctx->count >= FWDT_SCAN_MAX_RANGES)
+		return -ENOSPC;
+
+	blocks = fs->size / fs->block_size;
+	bounce = kmalloc(fs->block_size, GFP_KERNEL);
+	sr = kzalloc(sizeof(*sr), GFP_KERNEL);
+	if (!bounce || !sr)
+		goto err;
+
+	sr->hashes = vmalloc(blocks * sizeof(u32));
+	if (!sr->hashes)
+		goto err;
+
+	sr->virt = ioremap(fs->address, fs->size);
+	if (!sr->virt) {
+		ret = -ENXIO;
+		goto err;
+	}
+
+	for (i = 0; i < blocks; i++) {
+		memcpy_fromio(bounce, sr->virt + i * fs->block_size,
+			      fs->block_size);
+		sr->hashes[i] = fwdt_scan_hash(bounce, fs->block_size);
+		cond_resched();
+	}
+
+	sr->id = fs->id = ++ctx->next_id;
+	sr->block_size = fs->block_size;
+	sr->address = fs->address;
+	sr->size = fs->size;
+	list_add_tail(&sr->list, &ctx->ranges);
+	ctx->count++;
+	kfree(bounce);
+
+	return 0;
+ err:
+	if (sr)
+		vfree(sr->hashes);
+	kfree(sr);
+	kfree(bounce);
+	return ret;
+}
+
+/*
+ * Only blocks that are returned take their new hash, so a change that
+ * did not fit the buffer is still reported by the next scan.
+ */
+static int fwdt_scan_run(struct fwdt_scan_ctx *ctx, struct fwdt_mem_scan *fs)
+{
+	u8 __user *buf = (u8 __user *) (unsigned long) fs->buffer;
+	struct fwdt_scan_range *sr;
+	struct fwdt_scan_record rec;
+	cycles_t start;
+	u64 i, blocks;
+	u8 *bounce;
+	u32 hash;
+	int ret = 0;
+
+	fs->bytes = 0;
+	fs->changed = 0;
+	fs->pending = 0;
+
+	bounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!bounce)
+		return -ENOMEM;
+
+	list_for_each_entry(sr, &ctx->ranges, list) {
+		start = get_cycles();
+		blocks = sr->size / sr->block_size;
+		for (i = 0; i < blocks; i++) {
+			memcpy_fromio(bounce, sr->virt + i * sr->block_size,
+				      sr->block_size);
+			cond_resched();
+			hash = fwdt_scan_hash(bounce, sr->block_size);
+			if (hash == sr->hashes[i])
+				continue;
+
+			if (fs->buffer_size - fs->bytes <
+			    sizeof(rec) + sr->block_size) {
+				fs->pending++;
+				continue;
+			}
+
+			rec.id = sr->id;
+			rec.size = sr->block_size;
+			rec.offset = i * sr->block_size;
+			if (copy_to_user(buf + fs->bytes, &rec, sizeof(rec)) ||
+			    copy_to_user(buf + fs->bytes + sizeof(rec), bounce,
+					 sr->block_size)) {
+				ret = -EFAULT;
+				goto out;
+			}
+			fs->bytes += sizeof(rec) + sr->block_size;
+			fs->changed++;
+			sr->hashes[i] = hash;
+		}
+		trace_fwdt_mem_range(GET_DATA_BYTE, 0, sr->address, sr->size,
+				     0, get_cycles() - start);
+	}
+ out:
+	kfree(bounce);
+	return ret;
+}
+
+static int handle_mem_scan_cmd(struct file *file, fwdt_generic __user *fg)
+{
+	struct fwdt_file *ff = file->private_data;
+	struct fwdt_mem_scan fs;
+	u16 func;
+	int ret = 0;
+
+	if (copy_from_user(&fs, fg, sizeof(fs)))
+		return -EFAULT;
+
+	mutex_lock(&ff->lock);
+	func = fs.parameters.func;
+	switch (func) {
+	case ADD_SCAN_RANGE:
+		if (!ff->scan) {
+			ff->scan = kzalloc(sizeof(*ff->scan), GFP_KERNEL);
+			if (!ff->scan) {
+				ret = -ENOMEM;
+				goto err;
+			}
+			INIT_LIST_HEAD(&ff->scan->ranges);
+		}
+		ret = fwdt_scan_add(ff->scan, &fs);
+		if (ret)
+			goto err;
+		break;
+	case DEL_SCAN_RANGE:
+	case CLEAR_SCAN_RANGES:
+		/* ids start at 1, fwdt_scan_del() takes 0 to mean all */
+		if (!ff->scan || (func == DEL_SCAN_RANGE && !fs.id) ||
+		    !fwdt_scan_del(ff->scan,
+				   func == DEL_SCAN_RANGE ? fs.id : 0)) {
+			fs.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		break;
+	case RUN_SCAN:
+		if (!ff->scan || !ff->scan->count) {
+			fs.parameters.func_status = FWDT_DEVICE_NOT_FOUND;
+			goto out;
+		}
+		ret = fwdt_scan_run(ff->scan, &fs);
+		if (ret)
+			goto err;
+		break;
+	default:
+		ret = FWDT_FUNC_NOT_SUPPORTED;
+		goto err;
+	}
+
+	fs.parameters.func_status = FWDT_SUCCESS;
+ out:
+	if (copy_to_user(fg, &fs, sizeof(fs)))
+		ret = -EFAULT;
+ err:
+	mutex_unlock(&ff->lock);
+	return ret;
+}
+
+static long fwdt_runtime_dispatch(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	long err;
+
+	err = fwdt_core_ioctl(&fwdt_hw_backend, cmd, arg);
+	if (err != -ENOIOCTLCMD)
+		return err;
+
+	switch (cmd) {
+	case FWDT_MMAP_WINDOW_CMD:
+		err = handle_mmap_window_cmd((fwdt_generic __user *) arg);
+		break;
+	case FWDT_IOMAP_CACHE_CMD:
+		err = handle_iomap_cache_cmd((fwdt_generic __user *) arg);
+		break;
+	case FWDT_PCI_CONFIG_CMD:
+		err = handle_pci_config_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_MSR_MATRIX_CMD:
+		err = handle_msr_matrix_cmd((fwdt_generic __user *) arg);
+		break;
+	case FWDT_MSR_SAMPLER_CMD:
+		err = handle_msr_sampler_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_RING_CMD:
+		err = handle_ring_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_WATCH_CMD:
+		err = handle_watch_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_ACPI_EVENT_CMD:
+		err = handle_acpi_event_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_ACPI_EVAL_CMD:
+		err = handle_acpi_eval_cmd((fwdt_generic __user *) arg);
+		break;
+	case FWDT_SESSION_CMD:
+		err = handle_session_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	case FWDT_MEM_SCAN_CMD:
+		err = handle_mem_scan_cmd(file, (fwdt_generic __user *) arg);
+		break;
+	default:
+		err = FWDT_FUNC_NOT_SUPPORTED;
+		break;
+	}
+
+	return err;
+}
+
+static long fwdt_runtime_ioctl(struct file *file, unsigned int cmd,
+							unsigned long arg)
+{
+	fwdt_parameter __user *param = (fwdt_parameter __user *) arg;
+	unsigned int nr = _IOC_NR(cmd);
+	u16 func = 0, status = 0;
+	u64 start;
+	long err;
+
+	if (_IOC_TYPE(cmd) != 'p' || nr >= FWDT_STAT_IOCTLS)
+		nr = 0;
+	if (get_user(func, &param->func) || func >= FWDT_STAT_FUNCS)
+		func = 0;
+
+	start = ktime_to_ns(ktime_get());
+	err = fwdt_runtime_dispatch(file, cmd, arg);
+	if (!err && get_user(status, &param->func_status))
+		status = FWDT_FAIL;
+
+	fwdt_stat_record(ioctl_stats[nr], func, start, err || status);
+
+	return err;
+}
+
+static int fwdt_runtime_open(struct inode *inode, struct file *file)
+{
+	struct fwdt_file *ff;
+
+	ff = kzalloc(sizeof(*ff), GFP_KERNEL);
+	if (!ff)
+		return -ENOMEM;
+
+	mutex_init(&ff->lock);
+	file->private_data = ff;
+
+	return 0;
+}
+
+static int fwdt_runtime_close(struct inode *inode, struct file *file)
+{
+	struct fwdt_file *ff = file->private_data;
+
+	fwdt_sampler_free(ff->sampler);
+	fwdt_ring_free(ff->ring);
+	fwdt_watch_free(ff->watch);
+	fwdt_session_free(ff->session);
+	fwdt_scan_free(ff->scan);
+	fwdt_acpi_event_release(ff);
+	pci_dev_put(ff->pdev);
+	kfree(ff);
+
+	return 0;
+}
+
+static const struct file_operations fwdt_runtime_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl = fwdt_runtime_ioctl,
+	.read		= fwdt_runtime_read,
+	.write		= fwdt_runtime_write,
+	.poll		= fwdt_runtime_poll,
+	.open		= fwdt_runtime_open,
+	.release	= fwdt_runtime_close,
+	.mmap		= fwdt_runtime_mmap,
+	.llseek		= fwdt_runtime_llseek,
+};
+
+static struct miscdevice fwdt_runtime_dev = {
+	MISC_DYNAMIC_MINOR,
+	"fwdt",
+	&fwdt_runtime_fops
+};
+
+/* bulk reads through /dev/fwdt_mem map this much physical space at a time */
+#define FWDT_MEM_CHUNK	(64 * 1024)
+
+static bool fwdt_mem_readable(u64 address, size_t size)
+{
+	u64 pfn;
+
+	for (pfn = address >> PAGE_SHIFT;
+	     pfn <= (address + size - 1) >> PAGE_SHIFT; pfn++)
+		if (page_is_ram(pfn))
+			return false;
+
+	return true;
+}
+
+static ssize_t fwdt_mem_do_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	u64 address = *ppos;
+	void __iomem *mem;
+	void *bounce;
+	size_t done, chunk, off, n;
+	ssize_t ret = 0;
+	cycles_t start, cycles;
+
+	if (address + count < address)
+		return -EINVAL;
+
+	bounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!bounce)
+		return -ENOMEM;
+
+	for (done = 0; done < count; done += chunk, address += chunk) {
+		chunk = min_t(u64, count - done,
+			      FWDT_MEM_CHUNK - (address & (FWDT_MEM_CHUNK - 1)));
+
+		if (!fwdt_mem_readable(address, chunk)) {
+			ret = -EPERM;
+			break;
+		}
+
+		mem = ioremap(address, chunk);
+		if (!mem) {
+			ret = -EIO;
+			break;
+		}
+
+		cycles = 0;
+		for (off = 0; off < chunk; off += n) {
+			n = min_t(size_t, chunk - off, PAGE_SIZE);
+			start = get_cycles();
+			memcpy_fromio(bounce, mem + off, n);
+			cycles += get_cycles() - start;
+			if (copy_to_user(buf + done + off, bounce, n)) {
+				ret = -EFAULT;
+				break;
+			}
+		}
+		trace_fwdt_mem_range(GET_DATA_BYTE, 0, address, chunk, ret,
+				     cycles);
+
+		iounmap(mem);
+		if (ret)
+			break;
+	}
+
+	kfree(bounce);
+
+	if (!done)
+		return ret;
+
+	*ppos += done;
+	return done;
+}
+
+static ssize_t fwdt_mem_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	u64 start = ktime_to_ns(ktime_get());
+	ssize_t ret;
+
+	ret = fwdt_mem_do_read(file, buf, count, ppos);
+	fwdt_stat_record(mem_dev_stats, 0, start, ret < 0);
+
+	return ret;
+}
+
+static loff_t fwdt_mem_llseek(struct file *file, loff_t offset, int orig)
+{
+	switch (orig) {
+	case SEEK_CUR:
+		offset += file->f_pos;
+		/* fall through */
+	case SEEK_SET:
+		if (offset < 0)
+			return -EINVAL;
+		file->f_pos = offset;
+		return offset;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int fwdt_mem_open(struct inode *inode, struct file *file)
+{
+	if (!capable(CAP_SYS_RAWIO))
+		return -EPERM;
+
+	return 0;
+}
+
+/* splice() falls back to .read when no .splice_read is provided */
+static const struct file_operations fwdt_mem_fops = {
+	.owner		= THIS_MODULE,
+	.read		= fwdt_mem_read,
+	.open		= fwdt_mem_open,
+	.llseek		= fwdt_mem_llseek,
+};
+
+static struct miscdevice fwdt_mem_dev = {
+	MISC_DYNAMIC_MINOR,
+	"fwdt_mem",
+	&fwdt_mem_fops
+};
+
+static void cleanup_sysfs(struct platform_device *device)
+{
+	fwdt_device_remove_file(&device->dev, &dev_attr_acpi_method);
+	fwdt_device_remove_file(&device->dev, &dev_attr_acpi_arg0);
+	fwdt_device_remove_file(&device->dev, &dev_attr_acpi_method_1_1);
+	fwdt_device_remove_file(&device->dev, &dev_attr_acpi_method_0_1);
+	fwdt_device_remove_file(&device->dev, &dev_attr_acpi_method_0_0);
+	fwdt_device_remove_file(&device->dev, &dev_attr_video_device);
+	fwdt_device_remove_file(&device->dev, &dev_attr_video_brightness);
+	fwdt_device_remove_file(&device->dev, &dev_attr_mem_address);
+	fwdt_device_remove_file(&device->dev, &dev_attr_mem_data);
+	fwdt_device_remove_file(&device->dev, &dev_attr_mem_cache);
+	fwdt_device_remove_file(&device->dev, &dev_attr_iow_address);
+	fwdt_device_remove_file(&device->dev, &dev_attr_iow_data);
+	fwdt_device_remove_file(&device->dev, &dev_attr_iob_address);
+	fwdt_device_remove_file(&device->dev, &dev_attr_iob_data);
+	fwdt_device_remove_file(&device->dev, &dev_attr_pci_id);
+	fwdt_device_remove_file(&device->dev, &dev_attr_pci_reg);
+	fwdt_device_remove_file(&device->dev, &dev_attr_pci_data);
+	fwdt_device_remove_file(&device->dev, &dev_attr_cmos);
+	fwdt_device_remove_file(&device->dev, &dev_attr_msr);
+	fwdt_device_remove_bin_file(&device->dev, &bin_attr_io);
+	fwdt_device_remove_bin_file(&device->dev, &bin_attr_nvram);
+	fwdt_device_remove_bin_file(&device->dev, &bin_attr_pci_config);
+
+	if (video_device)
+		video_device = NULL;
+
+	if (ec_device) {
+		fwdt_device_remove_file(&device->dev, &dev_attr_ec_address);
+		fwdt_device_remove_file(&device->dev, &dev_attr_ec_data);
+		fwdt_device_remove_file(&device->dev, &dev_attr_ec_qmethod);
+		fwdt_device_remove_bin_file(&device->dev, &bin_attr_ec);
+		ec_device = NULL;
+	}
+}
+
+static int fwdt_setup(struct platform_device *device)
+{
+	int err;
+	acpi_status status;
+
+	err = fwdt_device_create_file(&device->dev, &dev_attr_acpi_method);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_acpi_arg0);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_acpi_method_1_1);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_acpi_method_0_1);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_acpi_method_0_0);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_video_device);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_video_brightness);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_mem_address);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_mem_data);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_mem_cache);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_iow_address);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_iow_data);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_iob_address);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_iob_data);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_pci_id);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_pci_reg);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_pci_data);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_cmos);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_file(&device->dev, &dev_attr_msr);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_bin_file(&device->dev, &bin_attr_io);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_bin_file(&device->dev, &bin_attr_nvram);
+	if (err)
+		goto add_sysfs_error;
+	err = fwdt_device_create_bin_file(&device->dev, &bin_attr_pci_config);
+	if (err)
+		goto add_sysfs_error;
+
+	status = acpi_get_devices("PNP0C09", acpi_handle_locate_callback,
+				  NULL, &ec_device);
+	if (ACPI_SUCCESS(status)) {
+		if (!ec_device)
+			goto add_sysfs_done;
+		err = fwdt_device_create_file(&device->dev, &dev_attr_ec_address);
+		if (err)
+			goto add_sysfs_error;
+		err = fwdt_device_create_file(&device->dev, &dev_attr_ec_data);
+		if (err)
+			goto add_sysfs_error;
+		err = fwdt_device_create_file(&device->dev, &dev_attr_ec_qmethod);
+		if (err)
+			goto add_sysfs_error;
+		err = fwdt_device_create_bin_file(&device->dev, &bin_attr_ec);
+		if (err)
+			goto add_sysfs_error;
+	}
+
+add_sysfs_done:
+
+	return 0;
+
+add_sysfs_error:
+	cleanup_sysfs(device);
+	return err;
+}
+
+static int __exit fwdt_remove(struct platform_device *device)
+{
+	cleanup_sysfs(device);
+	return 0;
+}
+
+static void fwdt_debugfs_init(void)
+{
+	fwdt_debugfs_dir = debugfs_create_dir("fwdt", NULL);
+	if (IS_ERR_OR_NULL(fwdt_debugfs_dir)) {
+		fwdt_debugfs_dir = NULL;
+		return;
+	}
+
+	debugfs_create_file("acpi_handle_cache", S_IRUGO, fwdt_debugfs_dir,
+			    NULL, &acpi_handle_cache_fops);
+	debugfs_create_file("pci_snapshot", S_IRUSR, fwdt_debugfs_dir,
+			    NULL, &pci_snapshot_fops);
+	debugfs_create_file("pci_snapshot_diff", S_IRUSR, fwdt_debugfs_dir,
+			    (void *) 1, &pci_snapshot_fops);
+	debugfs_create_file("stats", S_IRUSR | S_IWUSR, fwdt_debugfs_dir,
+			    NULL, &fwdt_stats_fops);
+	debugfs_create_file("aml_profile", S_IRUSR | S_IWUSR, fwdt_debugfs_dir,
+			    NULL, &aml_profile_fops);
+}
+
+static int __init fwdt_init(void)
+{
+	int err;
+	pr_info("initializing fwdt module\n");
+
+	/* before the driver, so fwdt_setup() wraps attributes into them */
+	fwdt_stats_init();
+
+	err = platform_driver_register(&fwdt_driver);
+	if (err)
+		goto err_driver_reg;
+	fwdt_platform_dev = platform_device_alloc("fwdt", -1);
+	if (!fwdt_platform_dev) {
+		err = -ENOMEM;
+		goto err_device_alloc;
+	}
+	err = platform_device_add(fwdt_platform_dev);
+	if (err)
+		goto err_device_add;
+
+	err = misc_register(&fwdt_runtime_dev);
+	if (err) {
+		printk(KERN_ERR "fwdt: can't misc_register on minor=%d\n",
+					MISC_DYNAMIC_MINOR);
+		goto err_driver_reg;
+	}
+
+	err = misc_register(&fwdt_mem_dev);
+	if (err) {
+		printk(KERN_ERR "fwdt: can't misc_register fwdt_mem on minor=%d\n",
+					MISC_DYNAMIC_MINOR);
+		misc_deregister(&fwdt_runtime_dev);
+		goto err_driver_reg;
+	}
+
+	memset(&pci_dev, 0xFF, sizeof(pci_dev));
+
+	if (ACPI_SUCCESS(acpi_install_table_handler(fwdt_acpi_table_handler,
+						    NULL))) {
+		acpi_table_handler_installed = true;
+	} else {
+		mutex_lock(&acpi_handle_lock);
+		fwdt_acpi_tables_changed();
+		mutex_unlock(&acpi_handle_lock);
+	}
+
+	fwdt_debugfs_init();
+
+	return 0;
+
+err_device_add:
+	platform_device_put(fwdt_platform_dev);
+err_device_alloc:
+	platform_driver_unregister(&fwdt_driver);
+err_driver_reg:
+	fwdt_stats_cleanup();
+
+	return err;
+}
+
+static void __exit fwdt_exit(void)
+{
+	pr_info("exiting fwdt module\n");
+	if (fwdt_platform_dev) {
+		platform_device_unregister(fwdt_platform_dev);
+		platform_driver_unregister(&fwdt_driver);
+	} 
+
+	misc_deregister(&fwdt_mem_dev);
+	misc_deregister(&fwdt_runtime_dev);
+	cancel_delayed_work_sync(&watch_work);
+	fwdt_iomap_flush();
+
+	debugfs_remove_recursive(fwdt_debugfs_dir);
+	fwdt_bcl_cache_cleanup();
+	fwdt_pci_snapshot_cleanup();
+	fwdt_stats_cleanup();
+	mutex_lock(&aml_profile_lock);
+	fwdt_aml_profile_flush();
+	mutex_unlock(&aml_profile_lock);
+	if (acpi_table_handler_installed)
+		acpi_remove_table_handler(fwdt_acpi_table_handler);
+	mutex_lock(&acpi_handle_lock);
+	fwdt_acpi_handle_flush();
+	mutex_unlock(&acpi_handle_lock);
+}
+
+module_init(fwdt_init);
+module_exit(fwdt_exit);
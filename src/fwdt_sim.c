@@ -0,0 +1,376 @@
+/*
+ * FWDT simulated hardware
+ *
+ * Copyright(C) 2012 Canonical Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Plain byte arrays standing in for IO space, a memory window, CMOS, PCI
+ * config space, EC RAM and MSRs, plus one LCD device for the brightness
+ * commands.  CMOS and the EC are serialized through their device lock
+ * including the simulated latency, as rtc_lock and the EC mutex do on real
+ * hardware; the other devices only hold theirs around the copy.
+ */
+
+#define pr_fmt(fmt) "fwdt_sim: " fmt
+
+#include <pthread.h>
+
+#include "fwdt_user.h"
+#include "fwdt_core.h"
+#include "fwdt_sim.h"
+
+#define FWDT_SIM_TARGETS	(FWDT_TARGET_ACPI + 1)
+#define FWDT_SIM_MSRS		256
+#define FWDT_SIM_BR_LEVELS	13
+
+/* returned by the ACPI ops for anything but the simulated LCD methods */
+#define FWDT_SIM_AE_NOT_FOUND	0x0005
+
+struct fwdt_sim_device {
+	pthread_mutex_t lock;
+	u8 *space;
+	size_t size;
+};
+
+static u8 sim_io[0x10000];
+static u8 sim_mem[FWDT_SIM_MEM_SIZE];
+static u8 sim_cmos[256];
+static u8 sim_pci[FWDT_SIM_PCI_DEVICES][4096];
+static u8 sim_ec[256];
+static u8 sim_msr[FWDT_SIM_CPUS][FWDT_SIM_MSRS * sizeof(u64)];
+
+static struct fwdt_sim_device io_dev = {
+	PTHREAD_MUTEX_INITIALIZER, sim_io, sizeof(sim_io)
+};
+static struct fwdt_sim_device mem_dev = {
+	PTHREAD_MUTEX_INITIALIZER, sim_mem, sizeof(sim_mem)
+};
+static struct fwdt_sim_device cmos_dev = {
+	PTHREAD_MUTEX_INITIALIZER, sim_cmos, sizeof(sim_cmos)
+};
+static struct fwdt_sim_device ec_dev = {
+	PTHREAD_MUTEX_INITIALIZER, sim_ec, sizeof(sim_ec)
+};
+static pthread_mutex_t pci_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t msr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t lcd_lock = PTHREAD_MUTEX_INITIALIZER;
+static u32 lcd_level = 100;
+static const u32 lcd_levels[FWDT_SIM_BR_LEVELS] = {
+	100, 50, 10, 20, 30, 40, 50, 60, 70, 80, 90, 95, 100
+};
+
+static unsigned long sim_latency[FWDT_SIM_TARGETS];
+
+void fwdt_sim_set_latency(u16 target, unsigned long ns)
+{
+	if (target < FWDT_SIM_TARGETS)
+		__atomic_store_n(&sim_latency[target], ns, __ATOMIC_RELAXED);
+}
+
+void fwdt_sim_reset(void)
+{
+	pthread_mutex_lock(&io_dev.lock);
+	memset(sim_io, 0, sizeof(sim_io));
+	pthread_mutex_unlock(&io_dev.lock);
+	pthread_mutex_lock(&mem_dev.lock);
+	memset(sim_mem, 0, sizeof(sim_mem));
+	pthread_mutex_unlock(&mem_dev.lock);
+	pthread_mutex_lock(&cmos_dev.lock);
+	memset(sim_cmos, 0, sizeof(sim_cmos));
+	pthread_mutex_unlock(&cmos_dev.lock);
+	pthread_mutex_lock(&pci_lock);
+	memset(sim_pci, 0, sizeof(sim_pci));
+	pthread_mutex_unlock(&pci_lock);
+	pthread_mutex_lock(&ec_dev.lock);
+	memset(sim_ec, 0, sizeof(sim_ec));
+	pthread_mutex_unlock(&ec_dev.lock);
+	pthread_mutex_lock(&msr_lock);
+	memset(sim_msr, 0, sizeof(sim_msr));
+	pthread_mutex_unlock(&msr_lock);
+	pthread_mutex_lock(&lcd_lock);
+	lcd_level = 100;
+	pthread_mutex_unlock(&lcd_lock);
+}
+
+/* spin rather than sleep, the way the driver waits on slow hardware */
+static void fwdt_sim_delay(u16 target, unsigned long count)
+{
+	unsigned long ns;
+	cycles_t end;
+
+	ns = __atomic_load_n(&sim_latency[target], __ATOMIC_RELAXED);
+	if (!ns || !count)
+		return;
+
+	end = get_cycles() + (cycles_t) ns * count;
+	while (get_cycles() < end)
+		;
+}
+
+static int fwdt_sim_width(u16 func)
+{
+	switch (func) {
+	case GET_DATA_BYTE:
+	case SET_DATA_BYTE:
+		return 1;
+	case GET_DATA_WORD:
+	case SET_DATA_WORD:
+		return 2;
+	case GET_DATA_DWORD:
+	case SET_DATA_DWORD:
+		return 4;
+	case GET_DATA_QWORD:
+	case SET_DATA_QWORD:
+		return 8;
+	}
+
+	return 0;
+}
+
+/* a little-endian access of up to max_width bytes at space[address] */
+static int fwdt_sim_rw(u8 *space, size_t size, int max_width, u16 func,
+		       u64 address, u64 *data)
+{
+	int width = fwdt_sim_width(func);
+	u64 value = 0;
+	int i;
+
+	if (!width || width > max_width)
+		return FWDT_FUNC_NOT_SUPPORTED;
+	if (address + width > size)
+		return FWDT_FAIL;
+
+	if (func & 1) {
+		for (i = width - 1; i >= 0; i--)
+			value = value << 8 | space[address + i];
+		*data = value;
+	} else {
+		value = *data;
+		for (i = 0; i < width; i++, value >>= 8)
+			space[address + i] = value;
+	}
+
+	return FWDT_SUCCESS;
+}
+
+static int fwdt_sim_access(struct fwdt_sim_device *dev, u16 target,
+			   int max_width, bool serialize, u16 func,
+			   u64 address, u64 *data)
+{
+	int ret;
+
+	if (!serialize)
+		fwdt_sim_delay(target, 1);
+	pthread_mutex_lock(&dev->lock);
+	if (serialize)
+		fwdt_sim_delay(target, 1);
+	ret = fwdt_sim_rw(dev->space, dev->size, max_width, func, address,
+			  data);
+	pthread_mutex_unlock(&dev->lock);
+
+	return ret;
+}
+
+static int fwdt_sim_io(u16 func, u16 port, u64 *data)
+{
+	return fwdt_sim_access(&io_dev, FWDT_TARGET_IO, 4, false, func, port,
+			       data);
+}
+
+static void fwdt_sim_io_range(u16 func, u16 port, u8 width, void *buf,
+			      u32 count)
+{
+	size_t size = (size_t) count * width;
+	u32 i;
+
+	if (port + width > sizeof(sim_io))
+		return;
+
+	fwdt_sim_delay(FWDT_TARGET_IO, count);
+	pthread_mutex_lock(&io_dev.lock);
+	switch (func) {
+	case READ_IO_FIFO:
+		for (i = 0; i < count; i++)
+			memcpy((u8 *) buf + i * width, &sim_io[port], width);
+		break;
+	case WRITE_IO_FIFO:
+		/* a FIFO keeps only the last value written */
+		memcpy(&sim_io[port], (u8 *) buf + size - width, width);
+		break;
+	case READ_IO_RANGE:
+		memcpy(buf, &sim_io[port], size);
+		break;
+	case WRITE_IO_RANGE:
+		memcpy(&sim_io[port], buf, size);
+		break;
+	}
+	pthread_mutex_unlock(&io_dev.lock);
+}
+
+static int fwdt_sim_mem(u16 func, u64 address, u64 *data)
+{
+	return fwdt_sim_access(&mem_dev, FWDT_TARGET_MEMORY, 4, false, func,
+			       address & (FWDT_SIM_MEM_SIZE - 1), data);
+}
+
+static int fwdt_sim_cmos(u16 func, u64 address, u64 *data)
+{
+	return fwdt_sim_access(&cmos_dev, FWDT_TARGET_CMOS, 1, true, func,
+			       address, data);
+}
+
+static int fwdt_sim_range(struct fwdt_sim_device *dev, u16 target,
+			  bool read, unsigned int offset, u8 *buf,
+			  size_t length)
+{
+	if (offset + length > dev->size)
+		return -EINVAL;
+
+	pthread_mutex_lock(&dev->lock);
+	fwdt_sim_delay(target, length);
+	if (read)
+		memcpy(buf, dev->space + offset, length);
+	else
+		memcpy(dev->space + offset, buf, length);
+	pthread_mutex_unlock(&dev->lock);
+
+	return 0;
+}
+
+static int fwdt_sim_cmos_range(u16 func, unsigned int offset, u8 *buf,
+			       size_t length)
+{
+	return fwdt_sim_range(&cmos_dev, FWDT_TARGET_CMOS,
+			      func == READ_CMOS_RANGE, offset, buf, length);
+}
+
+static int fwdt_sim_pci(u16 func, u32 device, u64 address, u64 *data)
+{
+	int ret;
+
+	if (address > 0xFFF)
+		return FWDT_FAIL;
+	if (device >= FWDT_SIM_PCI_DEVICES)
+		return FWDT_DEVICE_NOT_FOUND;
+
+	fwdt_sim_delay(FWDT_TARGET_PCI, 1);
+	pthread_mutex_lock(&pci_lock);
+	ret = fwdt_sim_rw(sim_pci[device], sizeof(sim_pci[device]), 4, func,
+			  address, data);
+	pthread_mutex_unlock(&pci_lock);
+
+	return ret;
+}
+
+static int fwdt_sim_ec(u16 func, u64 address, u64 *data)
+{
+	if (address > 0xFF)
+		return FWDT_FAIL;
+
+	return fwdt_sim_access(&ec_dev, FWDT_TARGET_EC, 1, true, func,
+			       address, data);
+}
+
+static int fwdt_sim_ec_range(u16 func, unsigned int offset, u8 *buf,
+			     size_t length)
+{
+	return fwdt_sim_range(&ec_dev, FWDT_TARGET_EC,
+			      func == READ_EC_RANGE, offset, buf, length);
+}
+
+/* each CPU has FWDT_SIM_MSRS registers, aliased across the MSR space */
+static int fwdt_sim_msr(u16 func, u32 cpu, u64 address, u64 *data)
+{
+	int ret;
+
+	if (func != GET_DATA_QWORD && func != SET_DATA_QWORD)
+		return FWDT_FUNC_NOT_SUPPORTED;
+	if (cpu >= FWDT_SIM_CPUS)
+		return FWDT_FAIL;
+
+	fwdt_sim_delay(FWDT_TARGET_MSR, 1);
+	pthread_mutex_lock(&msr_lock);
+	ret = fwdt_sim_rw(sim_msr[cpu], sizeof(sim_msr[cpu]), 8, func,
+			  (address % FWDT_SIM_MSRS) * sizeof(u64), data);
+	pthread_mutex_unlock(&msr_lock);
+
+	return ret;
+}
+
+static int fwdt_sim_acpi_lookup(const char *path, void **handle)
+{
+	if (strcmp(path, FWDT_SIM_LCD_PATH))
+		return FWDT_SIM_AE_NOT_FOUND;
+
+	*handle = &lcd_level;
+	return 0;
+}
+
+static int fwdt_sim_acpi_integer(void *handle, const char *path,
+				 const char *method, u64 *arg, u64 *result)
+{
+	int status = 0;
+
+	fwdt_sim_delay(FWDT_TARGET_ACPI, 1);
+	pthread_mutex_lock(&lcd_lock);
+	if (!strcmp(method, "_BQC") && result)
+		*result = lcd_level;
+	else if (!strcmp(method, "_BCM") && arg)
+		lcd_level = *arg;
+	else
+		status = FWDT_SIM_AE_NOT_FOUND;
+	pthread_mutex_unlock(&lcd_lock);
+
+	return status;
+}
+
+static int fwdt_sim_br_levels(void *handle, u32 *levels, u32 *num_of_levels)
+{
+	fwdt_sim_delay(FWDT_TARGET_ACPI, 1);
+	memcpy(levels, lcd_levels, sizeof(lcd_levels));
+	*num_of_levels = FWDT_SIM_BR_LEVELS;
+
+	return 0;
+}
+
+const struct fwdt_backend fwdt_sim_backend = {
+	.io		= fwdt_sim_io,
+	.io_range	= fwdt_sim_io_range,
+	.mem		= fwdt_sim_mem,
+	.cmos		= fwdt_sim_cmos,
+	.cmos_range	= fwdt_sim_cmos_range,
+	.pci		= fwdt_sim_pci,
+	.ec		= fwdt_sim_ec,
+	.ec_range	= fwdt_sim_ec_range,
+	.msr		= fwdt_sim_msr,
+	.acpi_lookup	= fwdt_sim_acpi_lookup,
+	.acpi_integer	= fwdt_sim_acpi_integer,
+	.br_levels	= fwdt_sim_br_levels,
+};
+
+long fwdt_sim_ioctl(unsigned int cmd, void *arg)
+{
+	long err;
+
+	err = fwdt_core_ioctl(&fwdt_sim_backend, cmd, (unsigned long) arg);
+	if (err == -ENOIOCTLCMD)
+		err = FWDT_FUNC_NOT_SUPPORTED;
+
+	return err;
+}
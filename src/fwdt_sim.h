@@ -0,0 +1,29 @@
+#ifndef __FWDT_SIM_H__
+#define __FWDT_SIM_H__
+
+/*
+ * In-memory devices behind fwdt_core.c for userspace builds (libfwdtsim).
+ * Include after fwdtapp.h and fwdt.h.
+ */
+
+#define FWDT_SIM_MEM_SIZE	(1 << 20)	/* addresses wrap at this */
+#define FWDT_SIM_PCI_DEVICES	32		/* 0000:00:xx.x, devfn < 32 */
+#define FWDT_SIM_CPUS		4
+#define FWDT_SIM_LCD_PATH	"\\_SB.PCI0.GFX0.LCD"
+
+struct fwdt_backend;
+extern const struct fwdt_backend fwdt_sim_backend;
+
+/*
+ * Busy-wait ns on every access to an FWDT_TARGET_* device; a range access
+ * pays it once per element.  FWDT_TARGET_ACPI covers method evaluation.
+ */
+void fwdt_sim_set_latency(u16 target, unsigned long ns);
+
+/* clear all simulated device state, keeping the latencies */
+void fwdt_sim_reset(void);
+
+/* the driver's ioctl entry point for the commands fwdt_core.c handles */
+long fwdt_sim_ioctl(unsigned int cmd, void *arg);
+
+#endif
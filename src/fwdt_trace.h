@@ -0,0 +1,168 @@
+/*
+ * FWDT driver tracepoints
+ *
+ * Copyright(C) 2012 Canonical Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM fwdt
+
+#if !defined(_FWDT_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _FWDT_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* cycles is the TSC-measured duration of the hardware access alone */
+DECLARE_EVENT_CLASS(fwdt_access,
+
+	TP_PROTO(u16 func, u32 device, u64 address, u64 value, int status,
+		 u64 cycles),
+
+	TP_ARGS(func, device, address, value, status, cycles),
+
+	TP_STRUCT__entry(
+		__field(u16,	func)
+		__field(u32,	device)
+		__field(u64,	address)
+		__field(u64,	value)
+		__field(int,	status)
+		__field(u64,	cycles)
+	),
+
+	TP_fast_assign(
+		__entry->func = func;
+		__entry->device = device;
+		__entry->address = address;
+		__entry->value = value;
+		__entry->status = status;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("func=%u device=0x%x address=0x%llx value=0x%llx status=%d cycles=%llu",
+		  __entry->func, __entry->device, __entry->address,
+		  __entry->value, __entry->status, __entry->cycles)
+);
+
+#define FWDT_ACCESS_EVENT(name)						\
+DEFINE_EVENT(fwdt_access, name,						\
+	TP_PROTO(u16 func, u32 device, u64 address, u64 value,		\
+		 int status, u64 cycles),				\
+	TP_ARGS(func, device, address, value, status, cycles))
+
+FWDT_ACCESS_EVENT(fwdt_io);
+FWDT_ACCESS_EVENT(fwdt_mem);
+FWDT_ACCESS_EVENT(fwdt_pci);
+FWDT_ACCESS_EVENT(fwdt_ec);
+FWDT_ACCESS_EVENT(fwdt_msr);
+
+DECLARE_EVENT_CLASS(fwdt_range,
+
+	TP_PROTO(u16 func, u32 device, u64 address, u32 length, int status,
+		 u64 cycles),
+
+	TP_ARGS(func, device, address, length, status, cycles),
+
+	TP_STRUCT__entry(
+		__field(u16,	func)
+		__field(u32,	device)
+		__field(u64,	address)
+		__field(u32,	length)
+		__field(int,	status)
+		__field(u64,	cycles)
+	),
+
+	TP_fast_assign(
+		__entry->func = func;
+		__entry->device = device;
+		__entry->address = address;
+		__entry->length = length;
+		__entry->status = status;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("func=%u device=0x%x address=0x%llx length=%u status=%d cycles=%llu",
+		  __entry->func, __entry->device, __entry->address,
+		  __entry->length, __entry->status, __entry->cycles)
+);
+
+#define FWDT_RANGE_EVENT(name)						\
+DEFINE_EVENT(fwdt_range, name,						\
+	TP_PROTO(u16 func, u32 device, u64 address, u32 length,		\
+		 int status, u64 cycles),				\
+	TP_ARGS(func, device, address, length, status, cycles))
+
+FWDT_RANGE_EVENT(fwdt_io_range);
+FWDT_RANGE_EVENT(fwdt_mem_range);
+FWDT_RANGE_EVENT(fwdt_cmos_range);
+FWDT_RANGE_EVENT(fwdt_pci_range);
+FWDT_RANGE_EVENT(fwdt_ec_range);
+
+/* path is empty when the object was only known by its handle */
+TRACE_EVENT(fwdt_acpi_eval,
+
+	TP_PROTO(acpi_handle handle, const char *path, const char *method,
+		 u32 status, u64 cycles),
+
+	TP_ARGS(handle, path, method, status, cycles),
+
+	TP_STRUCT__entry(
+		__field(void *,		handle)
+		__string(path,		path ? path : "")
+		__string(method,	method ? method : "")
+		__field(u32,		status)
+		__field(u64,		cycles)
+	),
+
+	TP_fast_assign(
+		__entry->handle = handle;
+		__assign_str(path, path ? path : "");
+		__assign_str(method, method ? method : "");
+		__entry->status = status;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("handle=%p path=%s method=%s status=0x%x cycles=%llu",
+		  __entry->handle, __get_str(path), __get_str(method),
+		  __entry->status, __entry->cycles)
+);
+
+TRACE_EVENT(fwdt_brightness,
+
+	TP_PROTO(const char *path, u16 func, u32 level, int status,
+		 u64 cycles),
+
+	TP_ARGS(path, func, level, status, cycles),
+
+	TP_STRUCT__entry(
+		__string(path,		path ? path : "")
+		__field(u16,		func)
+		__field(u32,		level)
+		__field(int,		status)
+		__field(u64,		cycles)
+	),
+
+	TP_fast_assign(
+		__assign_str(path, path ? path : "");
+		__entry->func = func;
+		__entry->level = level;
+		__entry->status = status;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("path=%s func=%u level=%u status=%d cycles=%llu",
+		  __get_str(path), __entry->func, __entry->level,
+		  __entry->status, __entry->cycles)
+);
+
+#endif /* _FWDT_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE fwdt_trace
+#include <trace/define_trace.h>
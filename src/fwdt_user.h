@@ -0,0 +1,55 @@
+#ifndef __FWDT_USER_H__
+#define __FWDT_USER_H__
+
+/*
+ * Just enough of the kernel environment for fwdt_core.c to build as a
+ * userspace library.  "User" buffers are plain pointers into the caller's
+ * memory, so the uaccess helpers reduce to memcpy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "fwdtapp.h"
+#include "fwdt.h"
+
+#define __user
+
+#ifndef ENOIOCTLCMD
+#define ENOIOCTLCMD	515
+#endif
+
+#define GFP_KERNEL	0
+#define kmalloc(size, gfp)		malloc(size)
+#define kcalloc(n, size, gfp)		calloc(n, size)
+#define kfree(ptr)			free(ptr)
+
+#define copy_from_user(to, from, n)	(memcpy(to, from, n), 0)
+#define copy_to_user(to, from, n)	(memcpy(to, from, n), 0)
+
+#define min_t(type, x, y)	((type) (x) < (type) (y) ? (type) (x) : (type) (y))
+
+#define printk(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+
+/* cycles are nanoseconds here; nothing outside the tracepoints reads them */
+typedef unsigned long long cycles_t;
+
+static inline cycles_t get_cycles(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (cycles_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define trace_fwdt_brightness(path, func, level, status, cycles)	\
+	do { (void) (cycles); } while (0)
+
+#endif